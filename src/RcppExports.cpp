@@ -22,20 +22,65 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// do_adv_vector_time
-NumericVector do_adv_vector_time(NumericVector vvdStart, NumericVector vsdStart, NumericVector vsdTime, NumericVector vvdhStart, NumericVector vvdhTime, NumericVector n, NumericVector f);
-RcppExport SEXP _oce_do_adv_vector_time(SEXP vvdStartSEXP, SEXP vsdStartSEXP, SEXP vsdTimeSEXP, SEXP vvdhStartSEXP, SEXP vvdhTimeSEXP, SEXP nSEXP, SEXP fSEXP) {
+// do_ad2cp_beam_to_enu
+NumericVector do_ad2cp_beam_to_enu(NumericVector v, NumericMatrix tm, NumericMatrix rotation, IntegerVector nthreads);
+RcppExport SEXP _oce_do_ad2cp_beam_to_enu(SEXP vSEXP, SEXP tmSEXP, SEXP rotationSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type tm(tmSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type rotation(rotationSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ad2cp_beam_to_enu(v, tm, rotation, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ad2cp_columns
+List do_ad2cp_columns(RawVector buf, NumericVector index, IntegerVector ncells, IntegerVector nbeams);
+RcppExport SEXP _oce_do_ad2cp_columns(SEXP bufSEXP, SEXP indexSEXP, SEXP ncellsSEXP, SEXP nbeamsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ncells(ncellsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nbeams(nbeamsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ad2cp_columns(buf, index, ncells, nbeams));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_adv_vector
+List do_adv_vector(RawVector buf, NumericVector vvdStart, NumericVector look, NumericVector velocityScale, NumericVector vsdStart, NumericVector vsdTime, NumericVector vvdhStart, NumericVector vvdhTime, IntegerVector burst, NumericVector samplingRate, IntegerVector analog);
+RcppExport SEXP _oce_do_adv_vector(SEXP bufSEXP, SEXP vvdStartSEXP, SEXP lookSEXP, SEXP velocityScaleSEXP, SEXP vsdStartSEXP, SEXP vsdTimeSEXP, SEXP vvdhStartSEXP, SEXP vvdhTimeSEXP, SEXP burstSEXP, SEXP samplingRateSEXP, SEXP analogSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type vvdStart(vvdStartSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type look(lookSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type velocityScale(velocityScaleSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type vsdStart(vsdStartSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type vsdTime(vsdTimeSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type vvdhStart(vvdhStartSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type vvdhTime(vvdhTimeSEXP);
-    Rcpp::traits::input_parameter< NumericVector >::type n(nSEXP);
-    Rcpp::traits::input_parameter< NumericVector >::type f(fSEXP);
-    rcpp_result_gen = Rcpp::wrap(do_adv_vector_time(vvdStart, vsdStart, vsdTime, vvdhStart, vvdhTime, n, f));
+    Rcpp::traits::input_parameter< IntegerVector >::type burst(burstSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type samplingRate(samplingRateSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type analog(analogSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_adv_vector(buf, vvdStart, look, velocityScale, vsdStart, vsdTime, vvdhStart, vvdhTime, burst, samplingRate, analog));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_adv_vector_imu
+List do_adv_vector_imu(RawVector buf, NumericVector imuStart, IntegerVector nthreads);
+RcppExport SEXP _oce_do_adv_vector_imu(SEXP bufSEXP, SEXP imuStartSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type imuStart(imuStartSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_adv_vector_imu(buf, imuStart, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -139,6 +184,22 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// do_biosonics_pings
+List do_biosonics_pings(RawVector buf, NumericVector offset, IntegerVector ns, IntegerVector type, IntegerVector spp, IntegerVector nthreads);
+RcppExport SEXP _oce_do_biosonics_pings(SEXP bufSEXP, SEXP offsetSEXP, SEXP nsSEXP, SEXP typeSEXP, SEXP sppSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offset(offsetSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ns(nsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type type(typeSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type spp(sppSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_biosonics_pings(buf, offset, ns, type, spp, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // do_fill_gap_1d
 NumericVector do_fill_gap_1d(NumericVector x, NumericVector rule);
 RcppExport SEXP _oce_do_fill_gap_1d(SEXP xSEXP, SEXP ruleSEXP) {
@@ -239,8 +300,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // do_interp_barnes
-List do_interp_barnes(NumericVector x, NumericVector y, NumericVector z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations);
-RcppExport SEXP _oce_do_interp_barnes(SEXP xSEXP, SEXP ySEXP, SEXP zSEXP, SEXP wSEXP, SEXP xgSEXP, SEXP ygSEXP, SEXP xrSEXP, SEXP yrSEXP, SEXP gammaSEXP, SEXP iterationsSEXP) {
+List do_interp_barnes(NumericVector x, NumericVector y, NumericVector z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations, NumericVector cutoff, LogicalVector exact, IntegerVector nthreads);
+RcppExport SEXP _oce_do_interp_barnes(SEXP xSEXP, SEXP ySEXP, SEXP zSEXP, SEXP wSEXP, SEXP xgSEXP, SEXP ygSEXP, SEXP xrSEXP, SEXP yrSEXP, SEXP gammaSEXP, SEXP iterationsSEXP, SEXP cutoffSEXP, SEXP exactSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -254,7 +315,33 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< NumericVector >::type yr(yrSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type gamma(gammaSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type iterations(iterationsSEXP);
-    rcpp_result_gen = Rcpp::wrap(do_interp_barnes(x, y, z, w, xg, yg, xr, yr, gamma, iterations));
+    Rcpp::traits::input_parameter< NumericVector >::type cutoff(cutoffSEXP);
+    Rcpp::traits::input_parameter< LogicalVector >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_interp_barnes(x, y, z, w, xg, yg, xr, yr, gamma, iterations, cutoff, exact, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_interp_barnes_fields
+List do_interp_barnes_fields(NumericVector x, NumericVector y, NumericMatrix z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations, NumericVector cutoff, LogicalVector exact, IntegerVector nthreads);
+RcppExport SEXP _oce_do_interp_barnes_fields(SEXP xSEXP, SEXP ySEXP, SEXP zSEXP, SEXP wSEXP, SEXP xgSEXP, SEXP ygSEXP, SEXP xrSEXP, SEXP yrSEXP, SEXP gammaSEXP, SEXP iterationsSEXP, SEXP cutoffSEXP, SEXP exactSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type z(zSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type w(wSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xg(xgSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type yg(ygSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type xr(xrSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type yr(yrSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type gamma(gammaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cutoff(cutoffSEXP);
+    Rcpp::traits::input_parameter< LogicalVector >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_interp_barnes_fields(x, y, z, w, xg, yg, xr, yr, gamma, iterations, cutoff, exact, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -282,8 +369,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // do_ldc_ad2cp_in_file
-List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerVector to, IntegerVector by, IntegerVector DEBUG);
-RcppExport SEXP _oce_do_ldc_ad2cp_in_file(SEXP filenameSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP bySEXP, SEXP DEBUGSEXP) {
+List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerVector to, IntegerVector by, IntegerVector nthreads, IntegerVector DEBUG);
+RcppExport SEXP _oce_do_ldc_ad2cp_in_file(SEXP filenameSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP bySEXP, SEXP nthreadsSEXP, SEXP DEBUGSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -291,8 +378,36 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< IntegerVector >::type from(fromSEXP);
     Rcpp::traits::input_parameter< IntegerVector >::type to(toSEXP);
     Rcpp::traits::input_parameter< IntegerVector >::type by(bySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type DEBUG(DEBUGSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_ad2cp_in_file(filename, from, to, by, nthreads, DEBUG));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_ad2cp_time_window
+List do_ldc_ad2cp_time_window(CharacterVector filename, NumericVector from, NumericVector to, IntegerVector DEBUG);
+RcppExport SEXP _oce_do_ldc_ad2cp_time_window(SEXP filenameSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP DEBUGSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type to(toSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type DEBUG(DEBUGSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_ad2cp_time_window(filename, from, to, DEBUG));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_ad2cp_follow
+List do_ldc_ad2cp_follow(CharacterVector filename, NumericVector start, IntegerVector DEBUG);
+RcppExport SEXP _oce_do_ldc_ad2cp_follow(SEXP filenameSEXP, SEXP startSEXP, SEXP DEBUGSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type start(startSEXP);
     Rcpp::traits::input_parameter< IntegerVector >::type DEBUG(DEBUGSEXP);
-    rcpp_result_gen = Rcpp::wrap(do_ldc_ad2cp_in_file(filename, from, to, by, DEBUG));
+    rcpp_result_gen = Rcpp::wrap(do_ldc_ad2cp_follow(filename, start, DEBUG));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -313,6 +428,95 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// do_ldc_rdi_batch
+List do_ldc_rdi_batch(StringVector filename, NumericVector startIndex, IntegerVector n, IntegerVector checkLast, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_rdi_batch(SEXP filenameSEXP, SEXP startIndexSEXP, SEXP nSEXP, SEXP checkLastSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< StringVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type startIndex(startIndexSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type n(nSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type checkLast(checkLastSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_rdi_batch(filename, startIndex, n, checkLast, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_rdi_index
+List do_ldc_rdi_index(StringVector filename, IntegerVector startIndex, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_rdi_index(SEXP filenameSEXP, SEXP startIndexSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< StringVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type startIndex(startIndexSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_rdi_index(filename, startIndex, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_rdi_follow
+List do_ldc_rdi_follow(StringVector filename, NumericVector startIndex, IntegerVector checkLast, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_rdi_follow(SEXP filenameSEXP, SEXP startIndexSEXP, SEXP checkLastSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< StringVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type startIndex(startIndexSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type checkLast(checkLastSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_rdi_follow(filename, startIndex, checkLast, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_rdi_seek_time
+NumericVector do_ldc_rdi_seek_time(StringVector filename, IntegerVector time, IntegerVector startIndex, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_rdi_seek_time(SEXP filenameSEXP, SEXP timeSEXP, SEXP startIndexSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< StringVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type startIndex(startIndexSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_rdi_seek_time(filename, time, startIndex, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_rdi_from_index
+List do_ldc_rdi_from_index(StringVector filename, NumericVector ensemble_in_file, IntegerVector length, IntegerVector time, IntegerVector sec100, IntegerVector from, IntegerVector to, IntegerVector by, IntegerVector mode, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_rdi_from_index(SEXP filenameSEXP, SEXP ensemble_in_fileSEXP, SEXP lengthSEXP, SEXP timeSEXP, SEXP sec100SEXP, SEXP fromSEXP, SEXP toSEXP, SEXP bySEXP, SEXP modeSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< StringVector >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ensemble_in_file(ensemble_in_fileSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type length(lengthSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type sec100(sec100SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type to(toSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type by(bySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type mode(modeSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_rdi_from_index(filename, ensemble_in_file, length, time, sec100, from, to, by, mode, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
+// do_ldc_records
+List do_ldc_records(RawVector buf, List rules, IntegerVector debug);
+RcppExport SEXP _oce_do_ldc_records(SEXP bufSEXP, SEXP rulesSEXP, SEXP debugSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< List >::type rules(rulesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type debug(debugSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_ldc_records(buf, rules, debug));
+    return rcpp_result_gen;
+END_RCPP
+}
 // do_matrix_smooth
 NumericMatrix do_matrix_smooth(NumericMatrix mat);
 RcppExport SEXP _oce_do_matrix_smooth(SEXP matSEXP) {
@@ -364,6 +568,22 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// do_rdi_columns
+List do_rdi_columns(RawVector buf, NumericVector ensembleStart, IntegerVector ncells, IntegerVector nbeams, IntegerVector nvcells, IntegerVector ids);
+RcppExport SEXP _oce_do_rdi_columns(SEXP bufSEXP, SEXP ensembleStartSEXP, SEXP ncellsSEXP, SEXP nbeamsSEXP, SEXP nvcellsSEXP, SEXP idsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ensembleStart(ensembleStartSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ncells(ncellsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nbeams(nbeamsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nvcells(nvcellsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ids(idsSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_rdi_columns(buf, ensembleStart, ncells, nbeams, nvcells, ids));
+    return rcpp_result_gen;
+END_RCPP
+}
 // do_runlm
 List do_runlm(NumericVector x, NumericVector y, NumericVector xout, NumericVector window, NumericVector L);
 RcppExport SEXP _oce_do_runlm(SEXP xSEXP, SEXP ySEXP, SEXP xoutSEXP, SEXP windowSEXP, SEXP LSEXP) {
@@ -411,6 +631,20 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// do_sontek_adp_profiles
+List do_sontek_adp_profiles(RawVector buf, IntegerVector start, IntegerVector sections, IntegerVector pcadp);
+RcppExport SEXP _oce_do_sontek_adp_profiles(SEXP bufSEXP, SEXP startSEXP, SEXP sectionsSEXP, SEXP pcadpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< RawVector >::type buf(bufSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type start(startSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type sections(sectionsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type pcadp(pcadpSEXP);
+    rcpp_result_gen = Rcpp::wrap(do_sontek_adp_profiles(buf, start, sections, pcadp));
+    return rcpp_result_gen;
+END_RCPP
+}
 // do_epic_time_to_ymdhms
 List do_epic_time_to_ymdhms(IntegerVector julianDay, IntegerVector millisecond);
 RcppExport SEXP _oce_do_epic_time_to_ymdhms(SEXP julianDaySEXP, SEXP millisecondSEXP) {
@@ -1,6 +1,7 @@
 /* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
 
 #include <Rcpp.h>
+#include <vector>
 using namespace Rcpp;
 
 // Cross-reference work:
@@ -35,3 +36,132 @@ NumericMatrix do_ad2cp_ahrs(NumericMatrix v, NumericMatrix ahrs)
     return(enu);
 }
 
+
+// Rotation matrix, stored by rows in r[0..8], that is equivalent to the
+// quaternion (w,x,y,z). The quaternion need not be normalized.
+static void ad2cp_quaternion_matrix(double w, double x, double y, double z, double *r)
+{
+  double s = w*w + x*x + y*y + z*z;
+  s = s > 0.0 ? 2.0 / s : 0.0;
+  r[0] = 1.0 - s*(y*y + z*z); r[1] = s*(x*y - w*z);       r[2] = s*(x*z + w*y);
+  r[3] = s*(x*y + w*z);       r[4] = 1.0 - s*(x*x + z*z); r[5] = s*(y*z - w*x);
+  r[6] = s*(x*z - w*y);       r[7] = s*(y*z + w*x);       r[8] = 1.0 - s*(x*x + y*y);
+}
+
+// Profiles are handled in blocks of this many, so that the innermost
+// loop steps through adjacent elements of the (time,cell,beam) arrays.
+#define AD2CP_ENU_BLOCK 256
+
+/*
+
+Transform AD2CP velocities from beam to ENU coordinates
+
+@description
+
+Transform along-beam velocities to east, north and up components in one
+pass, without the intermediate xyz array. For each profile and cell,
+the beam velocities are multiplied by 'tm' to get xyz velocities, and
+the first three of those are then rotated by the AHRS matrix for the
+profile; any further xyz components (e.g. the error velocity of a
+4-beam instrument) are returned unrotated. The profiles are split
+among 'nthreads' threads, if the package was compiled with OpenMP
+support.
+
+@param v numeric array of dimension (time,cell,beam) holding the
+beam velocities.
+
+@param tm numeric matrix with as many columns as there are beams, and
+at least 3 rows, that transforms beam velocities to xyz velocities,
+as in beamToXyzAdpAD2CP().
+
+@param rotation numeric matrix with a row for each profile. If it has
+9 columns, they hold the AHRS rotation matrix by rows, as in
+xyzToEnuAdpAD2CP(). If it has 4 columns, they hold the quaternion
+(w,x,y,z) that is equivalent to that matrix.
+
+@param nthreads integer giving the number of threads to use.
+
+@value a numeric array of dimension (time,cell,nrow(tm)), holding the
+east, north and up velocities, followed by any other components.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+NumericVector do_ad2cp_beam_to_enu(NumericVector v, NumericMatrix tm, NumericMatrix rotation, IntegerVector nthreads)
+{
+  IntegerVector dim = v.attr("dim");
+  if (dim.size() != 3)
+    ::Rf_error("'v' must be a 3-dimensional array");
+  R_xlen_t N = dim[0];
+  int ncell = dim[1], nbeam = dim[2];
+  int nout = tm.nrow();
+  if (tm.ncol() != nbeam)
+    ::Rf_error("ncol(tm) must equal the number of beams, %d, but it is %d", nbeam, tm.ncol());
+  if (nout < 3)
+    ::Rf_error("nrow(tm) must be at least 3, but it is %d", nout);
+  int nrot = rotation.ncol();
+  if (nrot != 9 && nrot != 4)
+    ::Rf_error("ncol(rotation) must be 9 (AHRS matrix) or 4 (quaternion), but it is %d", nrot);
+  if (rotation.nrow() != N)
+    ::Rf_error("nrow(rotation) must equal dim(v)[1], %ld, but it is %d", (long)N, rotation.nrow());
+  int nthreads_value = nthreads[0] < 1 ? 1 : nthreads[0];
+  NumericVector res(N * ncell * (R_xlen_t)nout);
+  res.attr("dim") = IntegerVector::create(N, ncell, nout);
+  if (N == 0 || ncell == 0)
+    return(res);
+  const double *pv = &v[0], *prot = &rotation[0];
+  double *pres = &res[0];
+  std::vector<double> T(nout * nbeam);
+  for (int m = 0; m < nout; m++)
+    for (int k = 0; k < nbeam; k++)
+      T[m * nbeam + k] = tm(m, k);
+  const double *pT = &T[0];
+  R_xlen_t slab = N * ncell; // stride between beams, or components
+  R_xlen_t nblock = (N + AD2CP_ENU_BLOCK - 1) / AD2CP_ENU_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads_value)
+#endif
+  {
+    std::vector<double> R(9 * AD2CP_ENU_BLOCK), b(nbeam), xyz(nout);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (R_xlen_t block = 0; block < nblock; block++) {
+      R_xlen_t i0 = block * AD2CP_ENU_BLOCK;
+      R_xlen_t i1 = i0 + AD2CP_ENU_BLOCK < N ? i0 + AD2CP_ENU_BLOCK : N;
+      for (R_xlen_t i = i0; i < i1; i++) {
+        double *r = &R[9 * (i - i0)];
+        if (nrot == 9) {
+          for (int k = 0; k < 9; k++)
+            r[k] = prot[i + N * k];
+        } else {
+          ad2cp_quaternion_matrix(prot[i], prot[i + N], prot[i + 2*N], prot[i + 3*N], r);
+        }
+      }
+      for (int j = 0; j < ncell; j++) {
+        for (R_xlen_t i = i0; i < i1; i++) {
+          R_xlen_t o = i + N * j;
+          for (int k = 0; k < nbeam; k++)
+            b[k] = pv[o + slab * k];
+          for (int m = 0; m < nout; m++) {
+            double s = 0.0;
+            for (int k = 0; k < nbeam; k++)
+              s += pT[m * nbeam + k] * b[k];
+            xyz[m] = s;
+          }
+          const double *r = &R[9 * (i - i0)];
+          pres[o] = r[0]*xyz[0] + r[1]*xyz[1] + r[2]*xyz[2];
+          pres[o + slab] = r[3]*xyz[0] + r[4]*xyz[1] + r[5]*xyz[2];
+          pres[o + 2*slab] = r[6]*xyz[0] + r[7]*xyz[1] + r[8]*xyz[2];
+          for (int m = 3; m < nout; m++)
+            pres[o + m*slab] = xyz[m];
+        }
+      }
+    }
+  }
+  return(res);
+}
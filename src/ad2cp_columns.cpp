@@ -0,0 +1,231 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+#include <Rcpp.h>
+#include <string.h>
+#include <math.h>
+using namespace Rcpp;
+
+// Cross-reference work:
+// 1. update ../src/registerDynamicSymbol.c with an item for this
+// 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
+
+// Little-endian decoders, safe for any alignment and host byte order.
+static inline int ad2cp_int16(const unsigned char *p)
+{
+  return (short)((unsigned short)p[0] | ((unsigned short)p[1] << 8));
+}
+
+static inline unsigned int ad2cp_uint16(const unsigned char *p)
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static inline int ad2cp_int32(const unsigned char *p)
+{
+  return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+      ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static inline double ad2cp_float(const unsigned char *p)
+{
+  unsigned int u = (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+    ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+  float f;
+  memcpy(&f, &u, 4);
+  return((double)f);
+}
+
+// Bits in the 'configuration' field of a data record [1 page 48, table
+// 6.1.2], counting from 0 as in the Nortek documentation.
+#define AD2CP_VELOCITY 5
+#define AD2CP_AMPLITUDE 6
+#define AD2CP_CORRELATION 7
+#define AD2CP_ALTIMETER 8
+#define AD2CP_ALTIMETER_RAW 9
+#define AD2CP_AST 10
+#define AD2CP_ECHOSOUNDER 11
+#define AD2CP_AHRS 12
+
+/*
+
+Decode AD2CP burst/average data records
+
+@description
+
+Decode the fields that follow the fixed part of AD2CP data records
+that have the burst/average layout (i.e. 0x15, 0x16, 0x18, 0x1a
+and 0x1b), for a set of records that all have the same number of
+cells and beams. This does in a single pass over the records the work
+that read.adp.ad2cp() formerly did with readBin() calls inside a loop
+over records, without the need for large vectors of byte indices.
+
+@param buf raw vector holding the whole file.
+
+@param index numeric vector holding the locations of the records
+within buf, as returned by do_ldc_ad2cp_in_file(); byte k (counting
+from 0) of the data part of record i is buf[index[i]+k+1] in R
+notation.
+
+@param ncells,nbeams integers giving the number of cells and beams.
+
+@value a list holding items named "v" (velocity, in m/s, as an array
+with dimensions length(index), ncells and nbeams), "a" and "q" (raw
+arrays of amplitude and correlation, with the same dimensions),
+"altimeterDistance", "ASTDistance", "ASTPressure",
+"altimeterRawNumberOfSamples", "altimeterRawSampleDistance",
+"altimeterRawSamples", "echosounder" (a matrix with one row per
+record) and "AHRS" (a 9-column matrix). An item is present only if
+the 'configuration' field of at least one of the records indicates
+that the data are in the file; items in records that lack the data
+are NA (or 0 for raw arrays).
+
+@references
+
+1. Nortek AS. "Signature Integration 55|250|500|1000kHz." Nortek AS,
+2017.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_ad2cp_columns(RawVector buf, NumericVector index, IntegerVector ncells, IntegerVector nbeams)
+{
+  R_xlen_t nbuf = buf.size();
+  R_xlen_t N = index.size();
+  int ncell = ncells[0];
+  int nbeam = nbeams[0];
+  if (ncell < 0 || nbeam < 0)
+    ::Rf_error("ncells and nbeams must be non-negative, but they are %d and %d", ncell, nbeam);
+  R_xlen_t n = (R_xlen_t)ncell * nbeam;
+  const unsigned char *b = (const unsigned char *)RAW(buf);
+
+  // First pass: find which items are present in any of the records, so
+  // that we can allocate the output.
+  unsigned int any = 0;
+  for (R_xlen_t i = 0; i < N; i++) {
+    if (index[i] < 0 || index[i] + 4 > nbuf)
+      ::Rf_error("index[%ld]=%.0f is outside the buffer", (long)(i+1), index[i]);
+    any |= ad2cp_uint16(b + (R_xlen_t)index[i] + 2);
+  }
+#define HAVE(bit, conf) (((conf) >> (bit)) & 1)
+  NumericVector v, altimeterDistance, ASTDistance, ASTPressure, echosounder, AHRS;
+  IntegerVector altimeterRawNumberOfSamples, altimeterRawSampleDistance, altimeterRawSamples;
+  RawVector a, q;
+  if (HAVE(AD2CP_VELOCITY, any)) {
+    v = NumericVector(N * n, NA_REAL);
+    v.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (HAVE(AD2CP_AMPLITUDE, any)) {
+    a = RawVector(N * n);
+    a.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (HAVE(AD2CP_CORRELATION, any)) {
+    q = RawVector(N * n);
+    q.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (HAVE(AD2CP_ALTIMETER, any))
+    altimeterDistance = NumericVector(N, NA_REAL);
+  if (HAVE(AD2CP_AST, any)) {
+    ASTDistance = NumericVector(N, NA_REAL);
+    ASTPressure = NumericVector(N, NA_REAL);
+  }
+  if (HAVE(AD2CP_ALTIMETER_RAW, any)) {
+    altimeterRawNumberOfSamples = IntegerVector(N, NA_INTEGER);
+    altimeterRawSampleDistance = IntegerVector(N, NA_INTEGER);
+    altimeterRawSamples = IntegerVector(N, NA_INTEGER);
+  }
+  if (HAVE(AD2CP_ECHOSOUNDER, any)) {
+    echosounder = NumericVector(N * ncell, NA_REAL);
+    echosounder.attr("dim") = IntegerVector::create(N, ncell);
+  }
+  if (HAVE(AD2CP_AHRS, any)) {
+    AHRS = NumericVector(N * 9, NA_REAL);
+    AHRS.attr("dim") = IntegerVector::create(N, 9);
+  }
+
+  // Second pass: decode. Within a record, cells vary fastest, then
+  // beams; in the output arrays, records vary fastest.
+  for (R_xlen_t i = 0; i < N; i++) {
+    const unsigned char *p = b + (R_xlen_t)index[i];
+    unsigned int conf = ad2cp_uint16(p + 2);
+    // Find the record length, so we can check against overruns.
+    R_xlen_t need = 76;
+    if (HAVE(AD2CP_VELOCITY, conf)) need += 2 * n;
+    if (HAVE(AD2CP_AMPLITUDE, conf)) need += n;
+    if (HAVE(AD2CP_CORRELATION, conf)) need += n;
+    if (HAVE(AD2CP_ALTIMETER, conf)) need += 8;
+    if (HAVE(AD2CP_AST, conf)) need += 20;
+    if (HAVE(AD2CP_ALTIMETER_RAW, conf)) need += 8;
+    if (HAVE(AD2CP_ECHOSOUNDER, conf)) need += 2 * ncell;
+    if (HAVE(AD2CP_AHRS, conf)) need += 36;
+    if ((R_xlen_t)index[i] + need > nbuf)
+      ::Rf_error("data record %ld (at index %.0f) extends past the end of the buffer", (long)(i+1), index[i]);
+    const unsigned char *d = p + 76;
+    if (HAVE(AD2CP_VELOCITY, conf)) {
+      double factor = pow(10.0, (double)(signed char)p[58]);
+      for (R_xlen_t k = 0; k < n; k++)
+        v[i + N * k] = factor * ad2cp_int16(d + 2 * k);
+      d += 2 * n;
+    }
+    if (HAVE(AD2CP_AMPLITUDE, conf)) {
+      for (R_xlen_t k = 0; k < n; k++)
+        a[i + N * k] = d[k];
+      d += n;
+    }
+    if (HAVE(AD2CP_CORRELATION, conf)) {
+      for (R_xlen_t k = 0; k < n; k++)
+        q[i + N * k] = d[k];
+      d += n;
+    }
+    if (HAVE(AD2CP_ALTIMETER, conf)) {
+      // 4(distance)+2(quality)+2(status)
+      altimeterDistance[i] = ad2cp_float(d);
+      d += 8;
+    }
+    if (HAVE(AD2CP_AST, conf)) {
+      // 4(distance)+2(quality)+2(offset)+4(pressure)+8(spare)
+      ASTDistance[i] = ad2cp_float(d);
+      ASTPressure[i] = ad2cp_float(d + 8);
+      d += 20;
+    }
+    if (HAVE(AD2CP_ALTIMETER_RAW, conf)) {
+      altimeterRawNumberOfSamples[i] = ad2cp_int32(d);
+      altimeterRawSampleDistance[i] = ad2cp_uint16(d + 4);
+      altimeterRawSamples[i] = ad2cp_int16(d + 6); // 'signed frac' in docs
+      d += 8;
+    }
+    if (HAVE(AD2CP_ECHOSOUNDER, conf)) {
+      for (int k = 0; k < ncell; k++)
+        echosounder[i + N * k] = ad2cp_int16(d + 2 * k);
+      d += 2 * ncell;
+    }
+    if (HAVE(AD2CP_AHRS, conf)) {
+      for (int k = 0; k < 9; k++)
+        AHRS[i + N * k] = ad2cp_float(d + 4 * k);
+    }
+    if (i % 10000 == 0)
+      R_CheckUserInterrupt();
+  }
+
+  List res;
+  if (HAVE(AD2CP_VELOCITY, any)) res["v"] = v;
+  if (HAVE(AD2CP_AMPLITUDE, any)) res["a"] = a;
+  if (HAVE(AD2CP_CORRELATION, any)) res["q"] = q;
+  if (HAVE(AD2CP_ALTIMETER, any)) res["altimeterDistance"] = altimeterDistance;
+  if (HAVE(AD2CP_AST, any)) {
+    res["ASTDistance"] = ASTDistance;
+    res["ASTPressure"] = ASTPressure;
+  }
+  if (HAVE(AD2CP_ALTIMETER_RAW, any)) {
+    res["altimeterRawNumberOfSamples"] = altimeterRawNumberOfSamples;
+    res["altimeterRawSampleDistance"] = altimeterRawSampleDistance;
+    res["altimeterRawSamples"] = altimeterRawSamples;
+  }
+  if (HAVE(AD2CP_ECHOSOUNDER, any)) res["echosounder"] = echosounder;
+  if (HAVE(AD2CP_AHRS, any)) res["AHRS"] = AHRS;
+#undef HAVE
+  return(res);
+}
@@ -0,0 +1,327 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+#include <Rcpp.h>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+using namespace Rcpp;
+
+// Cross-reference work:
+// 1. update ../src/registerDynamicSymbol.c with an item for this
+// 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
+
+// Little-endian decoders, safe for any alignment and host byte order.
+static inline int vector_int16(const unsigned char *p)
+{
+  return (short)((unsigned short)p[0] | ((unsigned short)p[1] << 8));
+}
+
+static inline unsigned int vector_uint16(const unsigned char *p)
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+/*
+
+Decode Nortek Vector velocity data
+
+@description
+
+Decode the Vector Velocity Data records [1 p35] at the locations
+vvdStart[look], computing the time of each, in a single pass. Only
+the selected records are decoded, so the memory used is that of the
+result, even if 'look' selects a small fraction of a large file.
+
+Times are found by stepping forward from the most recent Vector
+System Data record (for continuous sampling) or the most recent Vector
+Velocity Data Header record (for burst sampling), at intervals of
+1/samplingRate. All the records in vvdStart are counted in this
+stepping, whether or not they are selected by 'look', so times are
+correct for any subsampling.
+
+@param buf raw vector holding the whole file.
+
+@param vvdStart numeric vector of the locations (counting from 1) of
+all the velocity records, as found by do_ldc_records().
+
+@param look numeric vector of indices into vvdStart, in increasing
+order, selecting the records to decode.
+
+@param velocityScale velocity in m/s, per unit of the 2-byte integers
+in the records.
+
+@param vsdStart,vsdTime locations and times of system-data records,
+used for continuous sampling.
+
+@param vvdhStart,vvdhTime locations and times of velocity-data
+header records, used for burst sampling.
+
+@param burst integer, 1 for burst sampling, or 0 for continuous
+sampling.
+
+@param samplingRate sampling rate, in Hz.
+
+@param analog integer vector of length 2, indicating whether to
+decode analog inputs 1 and 2.
+
+@value a list holding "v" (a matrix of velocity in m/s, with 3
+columns), "a" and "q" (raw matrices of amplitude and correlation),
+"pressure" (in dbar), "time" (in seconds since the epoch, NA for
+records preceding the first header, in burst mode), and, if requested,
+"analog1" and "analog2".
+
+@references
+
+1. Nortek AS. "System Integrator Guide (Paradopp Family of
+Products)." Nortek AS, June 2008.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_adv_vector(RawVector buf, NumericVector vvdStart, NumericVector look, NumericVector velocityScale,
+    NumericVector vsdStart, NumericVector vsdTime, NumericVector vvdhStart, NumericVector vvdhTime,
+    IntegerVector burst, NumericVector samplingRate, IntegerVector analog)
+{
+  R_xlen_t nbuf = buf.size();
+  R_xlen_t nvvd = vvdStart.size();
+  R_xlen_t N = look.size();
+  R_xlen_t nvsd = vsdStart.size();
+  R_xlen_t nvvdh = vvdhStart.size();
+  if (vsdTime.size() != nvsd)
+    ::Rf_error("vsdStart and vsdTime must have the same length, but they are %ld and %ld", (long)nvsd, (long)vsdTime.size());
+  if (vvdhTime.size() != nvvdh)
+    ::Rf_error("vvdhStart and vvdhTime must have the same length, but they are %ld and %ld", (long)nvvdh, (long)vvdhTime.size());
+  if (analog.size() != 2)
+    ::Rf_error("analog must have 2 elements, but it has %d", (int)analog.size());
+  if (samplingRate[0] <= 0)
+    ::Rf_error("samplingRate must be positive, but it is %f", samplingRate[0]);
+  int isBurst = burst[0] != 0;
+  if (isBurst && nvvdh < 1)
+    ::Rf_error("burst sampling requires at least one velocity-data header");
+  if (!isBurst && nvsd < 1)
+    ::Rf_error("continuous sampling requires at least one system-data record");
+  double dt = 1.0 / samplingRate[0];
+  double scale = velocityScale[0];
+  const unsigned char *b = (const unsigned char *)RAW(buf);
+
+  NumericMatrix v(N, 3);
+  RawMatrix a(N, 3), q(N, 3);
+  NumericVector pressure(N), time(N), analog1, analog2;
+  if (analog[0])
+    analog1 = NumericVector(N);
+  if (analog[1])
+    analog2 = NumericVector(N);
+
+  // 'ref' is the header (vsd or vvdh) that most recently precedes the
+  // record, or -1 if none does, and 'k' is the number of velocity
+  // records since it (or since the first record).
+  R_xlen_t ref = -1, k = 0;
+  const double *refStart = isBurst ? &vvdhStart[0] : &vsdStart[0];
+  const double *refTime = isBurst ? &vvdhTime[0] : &vsdTime[0];
+  R_xlen_t nref = isBurst ? nvvdh : nvsd;
+  R_xlen_t i = 0; // index into vvdStart
+  for (R_xlen_t m = 0; m < N; m++) {
+    R_xlen_t want = (R_xlen_t)look[m] - 1; // the 1 is to offset from R to C
+    if (ISNAN(look[m]) || want < 0 || want >= nvvd)
+      ::Rf_error("look[%ld]=%f is not an index into vvdStart, which has length %ld", (long)(m+1), look[m], (long)nvvd);
+    if (want < i - 1)
+      ::Rf_error("look must be in increasing order, but look[%ld]=%f", (long)(m+1), look[m]);
+    // Step through the records up to the wanted one, tracking time.
+    for (; i <= want; i++) {
+      int entered = 0;
+      while (ref + 1 < nref && refStart[ref + 1] < vvdStart[i]) {
+        ref++;
+        entered = 1;
+      }
+      if (entered)
+        k = 0;
+      else if (i > 0)
+        k++;
+    }
+    if (ref < 0)
+      time[m] = isBurst ? NA_REAL : refTime[0] + k * dt;
+    else
+      time[m] = refTime[ref] + k * dt;
+    R_xlen_t o = (R_xlen_t)vvdStart[want] - 1;
+    if (o < 0 || o + 24 > nbuf)
+      ::Rf_error("velocity record %ld (at vvdStart=%.0f) extends past the end of the buffer", (long)(want+1), vvdStart[want]);
+    const unsigned char *p = b + o;
+    // Vector Velocity Data [1 p35]
+    if (analog[1])
+      analog2[m] = (double)(p[2] | (p[5] << 8));
+    pressure[m] = (65536.0 * p[4] + vector_uint16(p + 6)) / 1000.0;
+    if (analog[0])
+      analog1[m] = vector_uint16(p + 8);
+    for (int beam = 0; beam < 3; beam++) {
+      v(m, beam) = scale * vector_int16(p + 10 + 2 * beam);
+      a(m, beam) = p[16 + beam];
+      q(m, beam) = p[19 + beam];
+    }
+    if (m % 100000 == 0)
+      R_CheckUserInterrupt();
+  }
+  List res;
+  res["v"] = v;
+  res["a"] = a;
+  res["q"] = q;
+  res["pressure"] = pressure;
+  res["time"] = time;
+  if (analog[0])
+    res["analog1"] = analog1;
+  if (analog[1])
+    res["analog2"] = analog2;
+  return(res);
+}
+
+// IMU record layouts [1B p30-32, 1C]. Each record holds two or three
+// triplets of 4-byte floats (x, y and z) starting at byte 6, then
+// possibly a 3x3 orientation matrix (stored by row), and then a
+// 4-byte timestamp in ticks of 16 microseconds [2 p78].
+typedef struct {
+  unsigned char id;
+  const char *type;
+  int length;
+  int ntriplet;
+  const char *triplet[3];
+  int rotation;
+  int time;
+} vector_imu_layout;
+
+static const vector_imu_layout vector_imu_layouts[4] = {
+  {0xc3, "c3", 72, 2, {"IMUdeltaAngle", "IMUdeltaVelocity", NULL}, 30, 66},
+  {0xcc, "cc", 86, 3, {"IMUaccel", "IMUangrt", "IMUmagrt"}, 42, 78},
+  {0xd2, "d2", 50, 3, {"IMUaccel", "IMUangrt", "IMUmagrt"}, -1, 42},
+  {0xd3, "d3", 50, 3, {"IMUdeltaAngle", "IMUdeltaVelocity", "IMUdeltaMagVector"}, -1, 42}
+};
+
+static inline double vector_float(const unsigned char *p)
+{
+  uint32_t u = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  float f;
+  memcpy(&f, &u, 4);
+  return (double)f;
+}
+
+static inline int vector_int32(const unsigned char *p)
+{
+  return (int)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+/*
+
+Decode Nortek Vector IMU data
+
+@description
+
+Decode the IMU (inertial motion unit) records [1B p30-32, 1C] at the
+locations imuStart. The type of IMU record (0xc3, 0xcc, 0xd2 or 0xd3)
+is taken from the first record, and a counting pass selects the
+records of that type, which sets the size of the result. The records
+are then decoded in parallel, if 'nthreads' exceeds 1 and the package
+was compiled with OpenMP support, with each thread filling its own
+part of the arrays.
+
+@param buf raw vector holding the whole file.
+
+@param imuStart numeric vector of the locations (counting from 1) of
+IMU records, as found by do_ldc_records().
+
+@param nthreads integer giving the number of threads to use.
+
+@value a list holding "type" (one of "c3", "cc", "d2" or "d3"),
+"skipped" (the number of records of other types, which are not
+decoded), and numeric vectors named as in read.adv.nortek(), e.g.
+"IMUaccelX", "IMUangrtY" and "IMUtime" (in seconds), plus, for types
+c3 and cc, the 3x3xN array "IMUrotation".
+
+@references
+
+1B. Nortek AS. "System Integrator Manual." Nortek AS, Dec 2014.
+
+1C. Nortek AS, personal communication about the c3 type, March 2016.
+
+2. MicroStrain. "3DM-GX3-15, -25 MIP Data Communications Protocol."
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_adv_vector_imu(RawVector buf, NumericVector imuStart, IntegerVector nthreads)
+{
+  R_xlen_t nbuf = buf.size();
+  R_xlen_t nimu = imuStart.size();
+  int nthreads_value = nthreads[0] < 1 ? 1 : nthreads[0];
+  if (nimu < 1)
+    ::Rf_error("need at least one IMU record");
+  const unsigned char *b = (const unsigned char *)RAW(buf);
+  // Counting pass: check the records, and find those of the type of
+  // the first one.
+  const vector_imu_layout *layout = NULL;
+  std::vector<R_xlen_t> offset;
+  offset.reserve(nimu);
+  for (R_xlen_t i = 0; i < nimu; i++) {
+    R_xlen_t o = (R_xlen_t)imuStart[i] - 1; // the 1 is to offset from R to C
+    if (ISNAN(imuStart[i]) || o < 0 || o + 6 > nbuf)
+      ::Rf_error("imuStart[%ld]=%f is not a location in the buffer", (long)(i+1), imuStart[i]);
+    if (layout == NULL) {
+      for (int t = 0; t < 4; t++)
+        if (b[o + 5] == vector_imu_layouts[t].id)
+          layout = &vector_imu_layouts[t];
+      if (layout == NULL)
+        ::Rf_error("unknown IMU type 0x%02x; only 0xc3, 0xcc, 0xd2 and 0xd3 are recognized", b[o + 5]);
+    }
+    if (b[o + 5] != layout->id)
+      continue;
+    if (o + layout->length > nbuf)
+      ::Rf_error("IMU record %ld (at imuStart=%.0f) extends past the end of the buffer", (long)(i+1), imuStart[i]);
+    offset.push_back(o);
+  }
+  R_xlen_t N = offset.size();
+  int nfield = 3 * layout->ntriplet;
+  std::vector<NumericVector> field(nfield);
+  std::vector<double*> fieldp(nfield);
+  for (int f = 0; f < nfield; f++) {
+    field[f] = NumericVector(N);
+    fieldp[f] = N > 0 ? &field[f][0] : NULL;
+  }
+  NumericVector rotation(layout->rotation < 0 ? 0 : 9 * N);
+  double *rotationp = rotation.size() > 0 ? &rotation[0] : NULL;
+  NumericVector time(N);
+  double *timep = N > 0 ? &time[0] : NULL;
+  // Decoding pass. Each record fills its own slots, so the records
+  // may be split among threads in any way.
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads_value) schedule(static)
+#endif
+  for (R_xlen_t i = 0; i < N; i++) {
+    const unsigned char *p = b + offset[i];
+    for (int f = 0; f < nfield; f++)
+      fieldp[f][i] = vector_float(p + 6 + 4 * f);
+    if (rotationp) {
+      for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+          rotationp[r + 3 * c + 9 * i] = vector_float(p + layout->rotation + 4 * (3 * r + c));
+    }
+    timep[i] = vector_int32(p + layout->time) / 62500.0;
+  }
+  List res;
+  res["type"] = layout->type;
+  res["skipped"] = (double)(nimu - N);
+  static const char *xyz[3] = {"X", "Y", "Z"};
+  for (int f = 0; f < nfield; f++)
+    res[(std::string(layout->triplet[f / 3]) + xyz[f % 3]).c_str()] = field[f];
+  if (layout->rotation >= 0) {
+    rotation.attr("dim") = IntegerVector::create(3, 3, N);
+    res["IMUrotation"] = rotation;
+  }
+  res["IMUtime"] = time;
+  return(res);
+}
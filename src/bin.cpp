@@ -2,13 +2,82 @@
 #include <Rdefines.h>
 #include <Rinternals.h>
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 //#define DEBUG
 
-// These functions use the STL function lower_bound to find the index of the
-// smallest break exceeding x[i].  Data exceeding the top break get index equal
-// to nbreak.
+// These functions find the index of the smallest break exceeding x[i], as
+// the STL function lower_bound would.  Data exceeding the top break get index
+// equal to nbreak.
+//
+// Breaks are usually uniform, e.g. from seq(), and then the index is computed
+// arithmetically, and adjusted by comparison with the neighbouring breaks, so
+// the result matches lower_bound even if rounding errors make the spacing
+// slightly irregular.  Otherwise, lower_bound is used.
+//
+// The data are split into 'nthreads' contiguous chunks, each accumulated in
+// its own counts and sums by one thread, and these are then added up in chunk
+// order.  For nthreads=1, the results are as if the data were handled one by
+// one; for larger values, the sums may differ by rounding errors.  The number
+// of chunks is limited for grids with many bins; see bin_nchunk().
+
+typedef struct {
+    std::vector<double> b; // sorted breaks
+    int uniform;
+    double b0, h;          // first break and spacing, if uniform
+} bin_axis;
+
+static void bin_axis_setup(bin_axis *a, int nbreaks, const double *breaks)
+{
+    a->b.assign(breaks, breaks + nbreaks);
+    if (!std::is_sorted(a->b.begin(), a->b.end()))
+        std::sort(a->b.begin(), a->b.end()); // STL wants breaks ordered
+    a->b0 = a->b[0];
+    a->h = (a->b[nbreaks-1] - a->b[0]) / (nbreaks - 1);
+    a->uniform = R_FINITE(a->b0) && R_FINITE(a->h) && a->h > 0.0;
+    for (int k = 1; a->uniform && k < nbreaks; k++) {
+        // a loose test suffices, since indices are checked against the breaks
+        if (fabs(a->b[k] - a->b[k-1] - a->h) > 1e-6 * a->h)
+            a->uniform = 0;
+    }
+}
+
+static inline int bin_axis_index(const bin_axis *a, double x)
+{
+    int n = a->b.size();
+    if (!a->uniform)
+        return std::lower_bound(a->b.begin(), a->b.end(), x) - a->b.begin();
+    if (!(x > a->b0)) // also catches NaN
+        return 0;
+    if (x > a->b[n-1])
+        return n;
+    double t = ceil((x - a->b0) / a->h);
+    int bi = t < 1.0 ? 1 : (t > n - 1 ? n - 1 : (int)t);
+    const double *b = &a->b[0];
+    while (b[bi-1] >= x) // b[0] < x, so this stops at bi=1
+        bi--;
+    while (b[bi] < x) // b[n-1] >= x, so this stops at bi=n-1
+        bi++;
+    return bi;
+}
+
+// Range of data for chunk 'c' of 'nc'
+#define CHUNK_START(c, nc, n) ((int)(((double)(c) * (n)) / (nc)))
+
+// Number of chunks for 'nthreads' threads, reduced if need be so that the
+// per-chunk arrays, of nchunk*nbin elements each, hold no more than
+// BIN_MAX_CELLS elements, or nx, if that is larger.  Without this, a 2D grid
+// with many bins would need a copy of its counts and sums for each thread.
+#define BIN_MAX_CELLS 4194304 /* 2^22 */
+static int bin_nchunk(int nthreads, int nx, int nbin)
+{
+    double limit = nx > BIN_MAX_CELLS ? nx : BIN_MAX_CELLS;
+    int nchunk = nthreads < 1 ? 1 : nthreads;
+    if ((double)nchunk * nbin > limit)
+        nchunk = (int)(limit / nbin);
+    return nchunk < 1 ? 1 : nchunk;
+}
 
 
 /*
@@ -28,57 +97,73 @@
 
 extern "C" {
     void bin_count_1d(int *nx, double *x, int *nxbreaks, double *xbreaks,
-            int *number, double *mean)
+            int *number, double *mean, int *nthreads)
     {
 
         if (*nxbreaks < 2)
             error("cannot have fewer than 1 break"); // already checked in R but be safe
-        std::vector<double> b(xbreaks, xbreaks + *nxbreaks);
-        std::sort(b.begin(), b.end()); // STL wants breaks ordered
-        for (int i = 0; i < (*nxbreaks-1); i++) {
-            number[i] = 0;
-        }
-        for (int i = 0; i < (*nx); i++) {
-            std::vector<double>::iterator lower_bound;
-            lower_bound = std::lower_bound(b.begin(), b.end(), x[i]);
-            int bi = lower_bound - b.begin();
-            if (bi > 0 && bi < (*nxbreaks)) {
-#ifdef DEBUG
-                Rprintf("x: %6.3f   bi: %d    (%f to %f)\n", x[i], bi, xbreaks[bi-1], xbreaks[bi]);
+        bin_axis bx;
+        bin_axis_setup(&bx, *nxbreaks, xbreaks);
+        int nbin = *nxbreaks - 1;
+        int nchunk = bin_nchunk(*nthreads, *nx, nbin);
+        std::vector<int> n((size_t)nchunk * nbin, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunk) schedule(static, 1)
 #endif
-                number[bi-1]++;
+        for (int c = 0; c < nchunk; c++) {
+            int *nc = &n[(size_t)c * nbin];
+            for (int i = CHUNK_START(c, nchunk, *nx); i < CHUNK_START(c + 1, nchunk, *nx); i++) {
+                int bi = bin_axis_index(&bx, x[i]);
+                if (bi > 0 && bi < (*nxbreaks)) {
+                    nc[bi-1]++;
+                }
             }
         }
+        for (int i = 0; i < nbin; i++) {
+            number[i] = 0;
+            for (int c = 0; c < nchunk; c++)
+                number[i] += n[(size_t)c * nbin + i];
+        }
     }
 }
 
 extern "C" {
     void bin_mean_1d(int *nx, double *x, double *f, int *nxbreaks, double *xbreaks,
-            int *number, double *mean)
+            int *number, double *mean, int *nthreads)
     {
 
         if (*nxbreaks < 2)
             error("cannot have fewer than 1 break"); // already checked in R but be safe
-        std::vector<double> b(xbreaks, xbreaks + *nxbreaks);
-        std::sort(b.begin(), b.end()); // STL wants breaks ordered
-        for (int i = 0; i < (*nxbreaks-1); i++) {
-            number[i] = 0;
-            mean[i] = 0.0;
-        }
-        for (int i = 0; i < (*nx); i++) {
-            if (!ISNA(f[i])) {
-                std::vector<double>::iterator lower_bound;
-                lower_bound = std::lower_bound(b.begin(), b.end(), x[i]);
-                int bi = lower_bound - b.begin();
-                if (bi > 0 && bi < (*nxbreaks)) {
-#ifdef DEBUG
-                    Rprintf("x: %6.3f   bi: %d    (%f to %f)\n", x[i], bi, xbreaks[bi-1], xbreaks[bi]);
+        bin_axis bx;
+        bin_axis_setup(&bx, *nxbreaks, xbreaks);
+        int nbin = *nxbreaks - 1;
+        int nchunk = bin_nchunk(*nthreads, *nx, nbin);
+        std::vector<int> n((size_t)nchunk * nbin, 0);
+        std::vector<double> sum((size_t)nchunk * nbin, 0.0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunk) schedule(static, 1)
 #endif
-                    number[bi-1]++;
-                    mean[bi-1] += f[i];
+        for (int c = 0; c < nchunk; c++) {
+            int *nc = &n[(size_t)c * nbin];
+            double *sumc = &sum[(size_t)c * nbin];
+            for (int i = CHUNK_START(c, nchunk, *nx); i < CHUNK_START(c + 1, nchunk, *nx); i++) {
+                if (!(std::isnan(f[i]) && ISNA(f[i]))) { // ISNA() is a function call
+                    int bi = bin_axis_index(&bx, x[i]);
+                    if (bi > 0 && bi < (*nxbreaks)) {
+                        nc[bi-1]++;
+                        sumc[bi-1] += f[i];
+                    }
                 }
             }
         }
+        for (int i = 0; i < nbin; i++) {
+            number[i] = 0;
+            mean[i] = 0.0;
+            for (int c = 0; c < nchunk; c++) {
+                number[i] += n[(size_t)c * nbin + i];
+                mean[i] += sum[(size_t)c * nbin + i];
+            }
+        }
         for (int i = 0; i < (*nxbreaks-1); i++) {
             if (number[i] > 0) {
                 mean[i] = mean[i] / number[i];
@@ -95,30 +180,37 @@ extern "C" {
     void bin_count_2d(int *nx, double *x, double *y,
             int *nxbreaks, double *xbreaks,
             int *nybreaks, double *ybreaks,
-            int *number, double *mean)
+            int *number, double *mean, int *nthreads)
     {
 #ifdef DEBUG
         Rprintf("nxbreaks: %d, nybreaks: %d\n", *nxbreaks, *nybreaks);
 #endif
         if (*nxbreaks < 2) error("cannot have fewer than 1 xbreak"); // already checked in R but be safe
         if (*nybreaks < 2) error("cannot have fewer than 1 ybreak"); // already checked in R but be safe
-        std::vector<double> bx(xbreaks, xbreaks + *nxbreaks);
-        std::sort(bx.begin(), bx.end()); // STL wants breaks ordered
-        std::vector<double> by(ybreaks, ybreaks + *nybreaks);
-        std::sort(by.begin(), by.end()); // STL wants breaks ordered
-        for (int bij = 0; bij < (*nxbreaks-1) * (*nybreaks-1); bij++) {
-            number[bij] = 0;
-        }
-        for (int i = 0; i < (*nx); i++) {
-            int bi = std::lower_bound(bx.begin(), bx.end(), x[i]) - bx.begin();
-            int bj = std::lower_bound(by.begin(), by.end(), y[i]) - by.begin();
-            if (bi > 0 && bj > 0 && bi < (*nxbreaks) && bj < (*nybreaks)) {
-#ifdef DEBUG
-                Rprintf("x: %6.3f, y: %6.3f, bi: %d, bj: %d\n", x[i], y[i], bi, bj);
+        bin_axis bx, by;
+        bin_axis_setup(&bx, *nxbreaks, xbreaks);
+        bin_axis_setup(&by, *nybreaks, ybreaks);
+        int nbin = (*nxbreaks-1) * (*nybreaks-1);
+        int nchunk = bin_nchunk(*nthreads, *nx, nbin);
+        std::vector<int> n((size_t)nchunk * nbin, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunk) schedule(static, 1)
 #endif
-                number[ij(bi-1, bj-1)]++;
+        for (int c = 0; c < nchunk; c++) {
+            int *nc = &n[(size_t)c * nbin];
+            for (int i = CHUNK_START(c, nchunk, *nx); i < CHUNK_START(c + 1, nchunk, *nx); i++) {
+                int bi = bin_axis_index(&bx, x[i]);
+                int bj = bin_axis_index(&by, y[i]);
+                if (bi > 0 && bj > 0 && bi < (*nxbreaks) && bj < (*nybreaks)) {
+                    nc[ij(bi-1, bj-1)]++;
+                }
             }
         }
+        for (int bij = 0; bij < nbin; bij++) {
+            number[bij] = 0;
+            for (int c = 0; c < nchunk; c++)
+                number[bij] += n[(size_t)c * nbin + bij];
+        }
     }
 }
 #undef ij
@@ -129,35 +221,46 @@ extern "C" {
     void bin_mean_2d(int *nx, double *x, double *y, double *f,
             int *nxbreaks, double *xbreaks,
             int *nybreaks, double *ybreaks,
-            int *fill, int *fillgap, int *number, double *mean)
+            int *fill, int *fillgap, int *number, double *mean, int *nthreads)
     {
 #ifdef DEBUG
         Rprintf("nxbreaks: %d, nybreaks: %d\n", *nxbreaks, *nybreaks);
 #endif
         if (*nxbreaks < 2) error("cannot have fewer than 1 xbreak"); // already checked in R but be safe
         if (*nybreaks < 2) error("cannot have fewer than 1 ybreak"); // already checked in R but be safe
-        std::vector<double> bx(xbreaks, xbreaks + *nxbreaks);
-        std::sort(bx.begin(), bx.end()); // STL wants breaks ordered
-        std::vector<double> by(ybreaks, ybreaks + *nybreaks);
-        std::sort(by.begin(), by.end()); // STL wants breaks ordered
-        for (int bij = 0; bij < (*nxbreaks-1) * (*nybreaks-1); bij++) {
-            number[bij] = 0;
-            mean[bij] = 0.0;
-        }
-        for (int i = 0; i < (*nx); i++) {
-            if (!ISNA(f[i])) {
-                int bi = std::lower_bound(bx.begin(), bx.end(), x[i]) - bx.begin();
-                int bj = std::lower_bound(by.begin(), by.end(), y[i]) - by.begin();
-                if (bi > 0 && bj > 0 && bi < (*nxbreaks) && bj < (*nybreaks)) {
-#ifdef DEBUG
-                    Rprintf("x: %6.3f, y: %6.3f, bi: %d, bj: %d\n", x[i], y[i], bi, bj);
+        bin_axis bx, by;
+        bin_axis_setup(&bx, *nxbreaks, xbreaks);
+        bin_axis_setup(&by, *nybreaks, ybreaks);
+        int nbin = (*nxbreaks-1) * (*nybreaks-1);
+        int nchunk = bin_nchunk(*nthreads, *nx, nbin);
+        std::vector<int> n((size_t)nchunk * nbin, 0);
+        std::vector<double> sum((size_t)nchunk * nbin, 0.0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunk) schedule(static, 1)
 #endif
-                    number[ij(bi-1, bj-1)]++;
-                    mean[ij(bi-1, bj-1)] += f[i];
+        for (int c = 0; c < nchunk; c++) {
+            int *nc = &n[(size_t)c * nbin];
+            double *sumc = &sum[(size_t)c * nbin];
+            for (int i = CHUNK_START(c, nchunk, *nx); i < CHUNK_START(c + 1, nchunk, *nx); i++) {
+                if (!(std::isnan(f[i]) && ISNA(f[i]))) { // ISNA() is a function call
+                    int bi = bin_axis_index(&bx, x[i]);
+                    int bj = bin_axis_index(&by, y[i]);
+                    if (bi > 0 && bj > 0 && bi < (*nxbreaks) && bj < (*nybreaks)) {
+                        nc[ij(bi-1, bj-1)]++;
+                        sumc[ij(bi-1, bj-1)] += f[i];
+                    }
                 }
             }
         }
-        for (int bij = 0; bij < (*nxbreaks-1) * (*nybreaks-1); bij++) {
+        for (int bij = 0; bij < nbin; bij++) {
+            number[bij] = 0;
+            mean[bij] = 0.0;
+            for (int c = 0; c < nchunk; c++) {
+                number[bij] += n[(size_t)c * nbin + bij];
+                mean[bij] += sum[(size_t)c * nbin + bij];
+            }
+        }
+        for (int bij = 0; bij < nbin; bij++) {
             if (number[bij] > 0) {
                 mean[bij] = mean[bij] / number[bij];
             } else {
@@ -9,6 +9,18 @@
 #include <R.h>
 #include <Rdefines.h>
 #include <Rinternals.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+/* AVX2 code is compiled for x86-64 with GCC or clang, and used only
+ * if the processor has AVX2 (see choose_find_bytes()). */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__INTEL_COMPILER)
+#define OCE_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#include "record_locator.h"
 
 //#define DEBUG
 
@@ -25,48 +37,181 @@
 
 */
 
+static SEXP locate_records(SEXP buf, const record_rule *rule, int max);
+static SEXP locate_records_of_types(SEXP buf, const record_rule *rules, int nrules, int max);
+
+/*
+ * Unwrap the sequence numbers (record counters) in 'seq', which are
+ * stored modulo 2^(8*bytes), for 'bytes' of 1, 2 or 4, in a single
+ * pass. A step of 1 is normal, and a larger step is taken to mean
+ * that records were lost, so a gap is recorded. A step of 0 (a repeat
+ * of the previous number), or a step back to one of the last
+ * SEQUENCE_RECENT numbers, is taken to mean that the record is a
+ * duplicate, and such records do not change the counter that later
+ * records are compared with. Any other step backwards (i.e. of at
+ * least half the counter range) is taken to mean that the counter was
+ * reset, e.g. because the instrument was restarted; the record is
+ * then taken to follow the previous one, and later records are
+ * compared with it. Thus a wrap is distinguished from a gap, provided
+ * that fewer than half the counter range of records are lost at once.
+ * NA values are skipped.
+ *
+ * The results are stored in 'unwrapped' (n values, NA where seq is
+ * NA), 'duplicate' (n values, 0 or 1), in 'gaps', which holds the
+ * R-style (i.e. starting at 1) index of each record that follows a gap
+ * and, in 'gaps_size', the number of records missing before it, and
+ * in 'resets', which holds the R-style index of each record at which
+ * the counter was reset.
+ */
+#define SEQUENCE_RECENT 16
+typedef struct {
+  R_xlen_t n, size;
+  double *index, *missing;
+} gap_list;
+
+static void gap_list_add(gap_list *gaps, R_xlen_t i, double missing)
+{
+  if (gaps->n >= gaps->size) {
+    gaps->size *= 2;
+    gaps->index = R_Realloc(gaps->index, gaps->size, double);
+    gaps->missing = R_Realloc(gaps->missing, gaps->size, double);
+  }
+  gaps->index[gaps->n] = (double)(i + 1); /* the 1 is to offset from C to R */
+  gaps->missing[gaps->n] = missing;
+  gaps->n++;
+}
+
+static void sequence_unwrap(const double *seq, R_xlen_t n, int bytes,
+    double *unwrapped, int *duplicate, gap_list *gaps, gap_list *resets)
+{
+  double modulus = bytes == 4 ? 4294967296.0 : (bytes == 2 ? 65536.0 : 256.0);
+  double half = modulus / 2;
+  int started = 0;
+  double last = 0.0, cumulative = 0.0;
+  double recent[SEQUENCE_RECENT]; /* the last numbers that were not duplicates */
+  R_xlen_t nrecent = 0;
+  for (R_xlen_t i = 0; i < n; i++) {
+    duplicate[i] = 0;
+    if (ISNAN(seq[i])) {
+      unwrapped[i] = NA_REAL;
+      continue;
+    }
+    double x = fmod(seq[i], modulus);
+    if (x < 0)
+      x += modulus; /* e.g. a 4-byte counter stored in a signed integer */
+    if (!started) {
+      started = 1;
+      last = x;
+      cumulative = x;
+      unwrapped[i] = x;
+      recent[nrecent++ % SEQUENCE_RECENT] = x;
+      continue;
+    }
+    double step = fmod(x - last + modulus, modulus);
+    if (step == 0.0 || step >= half) {
+      int seen = 0;
+      for (int k = 0; k < nrecent && k < SEQUENCE_RECENT; k++) {
+        if (recent[k] == x) {
+          seen = 1;
+          break;
+        }
+      }
+      if (seen) {
+        duplicate[i] = 1;
+        unwrapped[i] = cumulative - (step == 0.0 ? 0.0 : modulus - step);
+        continue;
+      }
+      gap_list_add(resets, i, 0.0);
+      step = 1.0;
+    } else if (step > 1.0) {
+      gap_list_add(gaps, i, step - 1.0);
+    }
+    cumulative += step;
+    last = x;
+    unwrapped[i] = cumulative;
+    recent[nrecent++ % SEQUENCE_RECENT] = x;
+  }
+}
+
+static int sequence_bytes(SEXP bytes)
+{
+  int b = asInteger(bytes);
+  if (b != 1 && b != 2 && b != 4)
+    error("bytes must be 1, 2 or 4, not %d", b);
+  return b;
+}
+
+/*
+ * Find gaps and duplicates in a sequence of record counters.
+ *
+ * @param seq numeric or integer vector of counters.
+ * @param bytes number of bytes in the counter (1, 2 or 4).
+ *
+ * @value a list holding 'unwrapped' (numeric), 'gap' (the indices of
+ * records that follow gaps), 'gapSize' (the number of records missing
+ * in each gap), 'duplicate' (logical) and 'reset' (the indices of
+ * records at which the counter was reset); see sequence_unwrap().
+ *
+ * g <- .Call("sequence_gaps", c(254, 255, 0, 3, 3, 4), 1L)
+ */
+SEXP sequence_gaps(SEXP seq, SEXP bytes)
+{
+  int b = sequence_bytes(bytes);
+  PROTECT(seq = AS_NUMERIC(seq));
+  R_xlen_t n = XLENGTH(seq);
+  SEXP unwrapped, duplicate, gap, gap_size, reset, res, names;
+  PROTECT(unwrapped = NEW_NUMERIC(n));
+  PROTECT(duplicate = NEW_LOGICAL(n));
+  gap_list gaps, resets;
+  gaps.n = resets.n = 0;
+  gaps.size = resets.size = 64;
+  gaps.index = R_Calloc(gaps.size, double);
+  gaps.missing = R_Calloc(gaps.size, double);
+  resets.index = R_Calloc(resets.size, double);
+  resets.missing = R_Calloc(resets.size, double);
+  sequence_unwrap(NUMERIC_POINTER(seq), n, b, NUMERIC_POINTER(unwrapped),
+      LOGICAL_POINTER(duplicate), &gaps, &resets);
+  PROTECT(gap = NEW_NUMERIC(gaps.n));
+  PROTECT(gap_size = NEW_NUMERIC(gaps.n));
+  PROTECT(reset = NEW_NUMERIC(resets.n));
+  if (gaps.n > 0) {
+    memcpy(NUMERIC_POINTER(gap), gaps.index, gaps.n * sizeof(double));
+    memcpy(NUMERIC_POINTER(gap_size), gaps.missing, gaps.n * sizeof(double));
+  }
+  if (resets.n > 0)
+    memcpy(NUMERIC_POINTER(reset), resets.index, resets.n * sizeof(double));
+  R_Free(gaps.index);
+  R_Free(gaps.missing);
+  R_Free(resets.index);
+  R_Free(resets.missing);
+  PROTECT(res = allocVector(VECSXP, 5));
+  SET_VECTOR_ELT(res, 0, unwrapped);
+  SET_VECTOR_ELT(res, 1, gap);
+  SET_VECTOR_ELT(res, 2, gap_size);
+  SET_VECTOR_ELT(res, 3, duplicate);
+  SET_VECTOR_ELT(res, 4, reset);
+  PROTECT(names = allocVector(STRSXP, 5));
+  SET_STRING_ELT(names, 0, mkChar("unwrapped"));
+  SET_STRING_ELT(names, 1, mkChar("gap"));
+  SET_STRING_ELT(names, 2, mkChar("gapSize"));
+  SET_STRING_ELT(names, 3, mkChar("duplicate"));
+  SET_STRING_ELT(names, 4, mkChar("reset"));
+  setAttrib(res, R_NamesSymbol, names);
+  UNPROTECT(8);
+  return(res);
+}
+
 SEXP unwrap_sequence_numbers(SEXP seq, SEXP bytes)
 {
   /* "unwrap" a vector of integers that are sequence numbers wrapping in 'bytes' bytes, 
    * creating the sequence numbers that might have resulted, had 'seq' not been
-   * created modulo 'bytes' bytes.
-   *
+   * created modulo 'bytes' bytes.  See sequence_gaps() for the handling
+   * of gaps, duplicates and resets.
    */
-  PROTECT(seq = AS_INTEGER(seq));
-  int *pseq = INTEGER_POINTER(seq);
-  PROTECT(bytes = AS_INTEGER(bytes));
-  int pbytes = *INTEGER_POINTER(bytes);
-  long int pmod;
-  if (pbytes == 2) {
-    pmod = 65535 + 1;
-  } else {
-    error("only understand bytes=2 for now");
-  }
-  long int n = LENGTH(seq);
-  SEXP res;
-  PROTECT(res = NEW_INTEGER(n));
-  int *pres = INTEGER_POINTER(res);
-  long int last;
-  long int cumulative = 0;
-#ifdef DEBUG
-  Rprintf("n=%ld\n", n);
-#endif
-  pres[0] = pseq[0];
-  last = pseq[0];
-  for (int i = 1; i < n; i++) {
-    if (pseq[i] < last) {
-      cumulative += pmod;
-#ifdef DEBUG
-      Rprintf("pseq[%d]=%d and last=%d, so updated to cumulative=%ld\n", i, pseq[i], last, cumulative);
-#endif
-    }
-    pres[i] = pseq[i] + cumulative;
-#ifdef DEBUG
-    Rprintf("i=%d seq=%d rval=%d\n", i, pseq[i], pres[i]);
-#endif
-    last = pseq[i];
-  }
-  UNPROTECT(3);
+  SEXP g, res;
+  PROTECT(g = sequence_gaps(seq, bytes));
+  res = VECTOR_ELT(g, 0);
+  UNPROTECT(1);
   return(res);
 }
 
@@ -120,85 +265,29 @@ c3 <- readBin(buf[p+15], "integer", signed=TRUE, size=1, n=np)
 temperature <- 0.01 * readBin(buf[sort(c(p, p+1))+16], "integer", signed=TRUE, size=2, endian="little",n=np)
 pressure <- readBin(buf[sort(c(p, p+1))+18], "integer", signed=TRUE, size=2, endian="little",n=np)
 */
-  unsigned char *pbuf;
   PROTECT(buf = AS_RAW(buf));
   PROTECT(max = AS_INTEGER(max));
-  /* FIXME: check lengths of match and key */
-  pbuf = RAW_POINTER(buf);
   int max_lres = *INTEGER_POINTER(max);
-  int lres;
-  int lbuf = LENGTH(buf);
-  SEXP res;
-#ifdef DEBUG
-  Rprintf("lbuf=%d, max=%d\n",lbuf,max_lres);
-#endif
-  /* Count matches, so we can allocate the right length */
-  unsigned char byte1 = 0x85;
-  unsigned char byte2 = 0x16; /* this equal 22 base 10, i.e. the number of bytes in record */
-  unsigned int matches = 0;
-  unsigned short int check_sum_start = ((unsigned short)0xa5<<8)  | ((unsigned short)0x96); /* manual p96 says 0xA596; assume little-endian */
-  unsigned short int check_sum, desired_check_sum;
   if (max_lres < 0)
     max_lres = 0;
-  for (int i = 0; i < lbuf - byte2; i++) { /* note that we don't look to the very end */
-    check_sum = check_sum_start;
-    if (pbuf[i] == byte1 && pbuf[i+1] == byte2) { /* match first 2 bytes, now check the checksum */
-#ifdef DEBUG
-      Rprintf("tentative match %d at i = %d ... ", matches, i);
-#endif
-      for (int c = 0; c < 20; c++)
-        check_sum += (unsigned short int)pbuf[i + c];
-      desired_check_sum = ((unsigned short)pbuf[i+20]) | ((unsigned short)pbuf[i+21] << 8);
-      if (check_sum == desired_check_sum) {
-        matches++;
-#ifdef DEBUG
-        Rprintf("good match (check_sum=%d)\n", check_sum);
-#endif
-        if (max_lres != 0 && matches >= max_lres)
-          break;
-      } else {
-#ifdef DEBUG
-        Rprintf("bad checksum\n");
-#endif
-      }
-    }
-  }
-  /* allocate space, then run through whole buffer again, noting the matches */
-  lres = matches;
-  if (lres > 0) {
-    PROTECT(res = NEW_INTEGER(lres));
-    int *pres = INTEGER_POINTER(res);
-#ifdef DEBUG
-    Rprintf("getting space for %d matches\n", lres);
-#endif
-    unsigned int ires = 0;
-    for (int i = 0; i < lbuf - byte2; i++) { /* note that we don't look to the very end */
-      check_sum = check_sum_start;
-      if (pbuf[i] == byte1 && pbuf[i+1] == byte2) { /* match first 2 bytes, now check the checksum */
-        for (int c = 0; c < 20; c++)
-          check_sum += (unsigned short int)pbuf[i + c];
-        desired_check_sum = ((unsigned short)pbuf[i+20]) | ((unsigned short)pbuf[i+21] << 8);
-        if (check_sum == desired_check_sum) {
-          pres[ires++] = i + 1; /* the +1 is to get R pointers */
-        }
-        if (ires > lres)        /* FIXME: or +1? */
-          break;
-      }
-    }
-    UNPROTECT(3);
-    return(res);
-  } else {
-    PROTECT(res = NEW_INTEGER(1));
-    int *pres = INTEGER_POINTER(res);
-    pres[0] = 0;
-    UNPROTECT(3);
-    return(res);
+  record_rule rule;
+  record_rule_init(&rule);
+  rule.sync[0] = 0x85;
+  rule.sync[1] = 0x16; /* this equal 22 base 10, i.e. the number of bytes in record */
+  rule.nsync = 2;
+  rule.length = 22;
+  rule.checksum = RECORD_CHECKSUM_SONTEK;
+  rule.seed = 0xa596; /* manual p96 says 0xA596; assume little-endian */
+  SEXP res = locate_records(buf, &rule, max_lres);
+  if (LENGTH(res) == 0) {
+    /* the calling code expects a 0 if there are no matches */
+    PROTECT(res = NEW_NUMERIC(1));
+    NUMERIC_POINTER(res)[0] = 0;
+    UNPROTECT(1);
   }
+  UNPROTECT(2);
+  return(res);
 }
-
-
-
-/*#define DEBUG*/
 SEXP nortek_checksum(SEXP buf, SEXP key)
 {
   /* http://www.nortek-as.com/en/knowledge-center/forum/current-profilers-and-current-meters/367698326 */
@@ -210,130 +299,301 @@ SEXP nortek_checksum(SEXP buf, SEXP key)
      vvd.start <- matchBytes(buf, 0xa5, 0x10)
      ok <- NULL;dyn.load("~/src/R-kelley/oce/src/bitwise.so");for(i in 1:200) {ok <- c(ok, .Call("nortek_checksum",buf[vvd.start[i]+0:23], c(0xb5, 0x8c)))}
      */
-  int i, n;
-  short check_value;
+  /* For many records, nortek_checksums() is much faster. */
   int *resp;
-  unsigned char *bufp, *keyp;
   SEXP res;
   PROTECT(key = AS_RAW(key));
   PROTECT(buf = AS_RAW(buf));
-  bufp = (unsigned char*)RAW_POINTER(buf);
-  keyp = (unsigned char*)RAW_POINTER(key);
-#ifdef DEBUG
-  Rprintf("buf[0]=0x%02x\n",bufp[0]);
-  Rprintf("buf[1]=0x%02x\n",bufp[1]);
-  Rprintf("buf[2]=0x%02x\n",bufp[2]);
-  Rprintf("key[0]=0x%02x\n", keyp[0]);
-  Rprintf("key[1]=0x%02x\n", keyp[1]);
+  unsigned char *bufp = (unsigned char*)RAW_POINTER(buf);
+  unsigned char *keyp = (unsigned char*)RAW_POINTER(key);
+  if (LENGTH(key) != 2) error("key length must be 2");
+  record_rule rule;
+  record_rule_init(&rule);
+  rule.checksum = RECORD_CHECKSUM_NORTEK;
+  rule.seed = (unsigned short)((keyp[0] << 8) | keyp[1]);
+  PROTECT(res = NEW_LOGICAL(1));
+  resp = LOGICAL_POINTER(res);
+  *resp = LENGTH(buf) >= 2 && record_checksum_ok(&rule, bufp, LENGTH(buf));
+  UNPROTECT(3);
+  return(res);
+}
+
+/*
+ * Check the checksums [SIG p33] of Nortek records starting at the
+ * R-style (i.e. starting at 1) indices 'offset' within 'buf',
+ * returning a logical vector.  If 'len' is positive, it gives the
+ * number of bytes in each record; otherwise, the length is taken from
+ * the number of 2-byte words stored at offset 2 in each record. 'key'
+ * holds the 2 bytes of the checksum seed, normally 0xb5 and 0x8c.
+ * Words are assembled in little-endian order, byte by byte, so the
+ * result does not depend on the processor, and unaligned records are
+ * handled.  Records that extend past the end of 'buf' are reported
+ * as failing.
+
+     buf <- readBin(f, what="raw", n=1e6)
+     vvdStart <- matchBytes(buf, 0xa5, 0x10)
+     ok <- .Call("nortek_checksums", buf, vvdStart, 24L, as.raw(c(0xb5, 0x8c)))
+ */
+SEXP nortek_checksums(SEXP buf, SEXP offset, SEXP len, SEXP key)
+{
+  PROTECT(buf = AS_RAW(buf));
+  PROTECT(offset = AS_NUMERIC(offset));
+  PROTECT(len = AS_INTEGER(len));
+  PROTECT(key = AS_RAW(key));
+  if (LENGTH(key) != 2) error("key length must be 2");
+  if (LENGTH(len) != 1) error("len must be a single integer");
+  unsigned char *bufp = RAW_POINTER(buf);
+  unsigned char *keyp = RAW_POINTER(key);
+  double *offsetp = NUMERIC_POINTER(offset);
+  int fixed = *INTEGER_POINTER(len);
+  if (fixed == NA_INTEGER)
+    fixed = 0;
+  R_xlen_t nbuf = XLENGTH(buf), n = XLENGTH(offset);
+  record_rule rule;
+  record_rule_init(&rule);
+  rule.checksum = RECORD_CHECKSUM_NORTEK;
+  rule.seed = (unsigned short)((keyp[0] << 8) | keyp[1]);
+  SEXP res;
+  PROTECT(res = NEW_LOGICAL(n));
+  int *resp = LOGICAL_POINTER(res);
+  for (R_xlen_t i = 0; i < n; i++) {
+    resp[i] = 0;
+    if (ISNAN(offsetp[i]) || offsetp[i] < 1)
+      continue;
+    R_xlen_t start = (R_xlen_t)offsetp[i] - 1; /* the 1 is to offset from R to C */
+    R_xlen_t nrec = fixed;
+    if (nrec <= 0) {
+      if (start + 4 > nbuf)
+        continue;
+      nrec = 2 * (R_xlen_t)record_uint16(bufp + start + 2);
+    }
+    if (nrec < 4 || start + nrec > nbuf)
+      continue;
+    resp[i] = record_checksum_ok(&rule, bufp + start, (int)nrec);
+  }
+  UNPROTECT(5);
+  return(res);
+}
+
+/*
+ * Sync-pattern search, used by match2bytes() and match3bytes().
+ *
+ * find_bytes() returns the lowest index i>=from at which the 'npat'
+ * (2 or 3) bytes of 'pat' start within the 'n' bytes of 'p', or -1
+ * if there is no such index.  On x86 processors, 16 (SSE2) or 32
+ * (AVX2, if the processor has it) starting positions are tested at
+ * once, by comparing the buffer at offsets 0, 1 and 2 with the bytes
+ * of the pattern, and and-ing the results.  Otherwise, memchr() is
+ * used to find candidates for the first byte.  Matches are sparse
+ * in instrument files (one per record), so the time is dominated by
+ * the comparisons, not by handling the matches.
+ */
+typedef R_xlen_t (*find_bytes_t)(const unsigned char *p, R_xlen_t n,
+    const unsigned char *pat, int npat, R_xlen_t from);
+
+static int lowest_bit(unsigned int mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int k = 0;
+  while (!(mask & 1U)) {
+    mask >>= 1;
+    k++;
+  }
+  return k;
 #endif
-  n = LENGTH(buf);
-  check_value = (((short)keyp[0]) << 8) | (short)keyp[1]; 
-#ifdef DEBUG
-  Rprintf("check_value= %d\n", check_value);
-  Rprintf("n=%d\n", n);
+}
+
+static R_xlen_t find_bytes_scalar(const unsigned char *p, R_xlen_t n,
+    const unsigned char *pat, int npat, R_xlen_t from)
+{
+  R_xlen_t last = n - npat; /* last possible start */
+  R_xlen_t i = from;
+  while (i <= last) {
+    const unsigned char *q = memchr(p + i, pat[0], (size_t)(last - i + 1));
+    if (!q)
+      return -1;
+    i = q - p;
+    if (p[i + 1] == pat[1] && (npat == 2 || p[i + 2] == pat[2]))
+      return i;
+    i++;
+  }
+  return -1;
+}
+
+#if defined(__SSE2__)
+static R_xlen_t find_bytes_sse2(const unsigned char *p, R_xlen_t n,
+    const unsigned char *pat, int npat, R_xlen_t from)
+{
+  R_xlen_t last = n - npat;
+  R_xlen_t i = from;
+  __m128i v0 = _mm_set1_epi8((char)pat[0]);
+  __m128i v1 = _mm_set1_epi8((char)pat[1]);
+  __m128i v2 = _mm_set1_epi8((char)pat[npat - 1]);
+  /* All 16 starts are in range, so the loads stay within the buffer */
+  for (; i + 15 <= last; i += 16) {
+    __m128i m = _mm_and_si128(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), v0),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 1)), v1));
+    if (npat == 3)
+      m = _mm_and_si128(m,
+          _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 2)), v2));
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+    if (mask)
+      return i + lowest_bit(mask);
+  }
+  return find_bytes_scalar(p, n, pat, npat, i);
+}
 #endif
-  short *sbufp = (short*) bufp;
-  for (i = 0; i < (n - 2)/2; i++) {
-#ifdef DEBUG
-    Rprintf("i=%d buf=0x%02x\n", i, sbufp[i]);
+
+#if defined(OCE_HAVE_AVX2)
+static __attribute__((target("avx2"))) R_xlen_t find_bytes_avx2(const unsigned char *p, R_xlen_t n,
+    const unsigned char *pat, int npat, R_xlen_t from)
+{
+  R_xlen_t last = n - npat;
+  R_xlen_t i = from;
+  __m256i v0 = _mm256_set1_epi8((char)pat[0]);
+  __m256i v1 = _mm256_set1_epi8((char)pat[1]);
+  __m256i v2 = _mm256_set1_epi8((char)pat[npat - 1]);
+  for (; i + 31 <= last; i += 32) {
+    __m256i m = _mm256_and_si256(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), v0),
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 1)), v1));
+    if (npat == 3)
+      m = _mm256_and_si256(m,
+          _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 2)), v2));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+    if (mask)
+      return i + lowest_bit(mask);
+  }
+  return find_bytes_scalar(p, n, pat, npat, i);
+}
 #endif
-    check_value += sbufp[i];
-#ifdef DEBUG
-    Rprintf("after, check_value=%d\n", check_value);
+
+static find_bytes_t choose_find_bytes(void)
+{
+#if defined(OCE_HAVE_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return find_bytes_avx2;
 #endif
-  }
-  short checksum;
-  checksum = (((short)bufp[n-1]) << 8) | (short)bufp[n-2];
-#ifdef DEBUG
-  Rprintf("CHECK AGAINST 0x%02x 0x%02x\n", bufp[n-2], bufp[n-1]);
-  Rprintf("CHECK AGAINST %d\n", checksum);
+#if defined(__SSE2__)
+  return find_bytes_sse2;
+#else
+  return find_bytes_scalar;
 #endif
-  PROTECT(res = NEW_LOGICAL(1));
-  resp = LOGICAL_POINTER(res);
-  *resp = check_value == checksum;
-  UNPROTECT(3);
+}
+
+/*
+ * Growable list of match locations, doubling in size as needed, so
+ * that the buffer need be scanned only once.
+ */
+typedef struct {
+  double *v;
+  R_xlen_t n, size;
+} match_list;
+
+static void match_list_push(match_list *m, double value)
+{
+  if (m->n >= m->size) {
+    m->size *= 2;
+    m->v = R_Realloc(m->v, m->size, double);
+  }
+  m->v[m->n++] = value;
+}
+
+static SEXP match_list_result(match_list *m)
+{
+  SEXP res;
+  PROTECT(res = NEW_NUMERIC(m->n));
+  if (m->n > 0)
+    memcpy(NUMERIC_POINTER(res), m->v, m->n * sizeof(double));
+  R_Free(m->v);
+  UNPROTECT(1);
   return(res);
 }
 
+/*
+ * Locate records of the types described by 'rules' (see
+ * record_locator.h), in a single pass through 'buf', returning the
+ * R-style (i.e. starting at 1) indices of their starts, in order.
+ * If max > 0, at most that many records are found.
+ */
+static SEXP locate_records_of_types(SEXP buf, const record_rule *rules, int nrules, int max)
+{
+  unsigned char *bufp = RAW_POINTER(buf);
+  R_xlen_t n = XLENGTH(buf);
+  record_scanner scanner;
+  record_scanner_init(&scanner, rules, nrules, NULL);
+  match_list m;
+  m.n = 0;
+  m.size = 1024;
+  m.v = R_Calloc(m.size, double);
+  R_xlen_t i = 0;
+  int type, len;
+  while ((i = record_next(&scanner, bufp, n, i, &type, &len)) >= 0) {
+    match_list_push(&m, (double)(i + 1)); /* the 1 is to offset from C to R */
+    if (max > 0 && m.n >= max)
+      break;
+    i += record_advance(&rules[type], len);
+  }
+  return(match_list_result(&m));
+}
+
+static SEXP locate_records(SEXP buf, const record_rule *rule, int max)
+{
+  return(locate_records_of_types(buf, rule, 1, max));
+}
+
+/*
+ * Find (non-overlapping) locations of a two-byte sequence in a
+ * buffer, returning the R-style (i.e. starting at 1) indices.
+ *
+ * If 'demand_sequential' is nonzero, then the two bytes following
+ * each match are taken as a little-endian sequence number, and
+ * matches are only accepted if that number is one more than the
+ * number for the previous accepted match (or 1, if the previous
+ * number was 65535).  The first match is always accepted.
+ */
 SEXP match2bytes(SEXP buf, SEXP m1, SEXP m2, SEXP demand_sequential)
 {
-  int i, j, n, n_match, ds;
-  double *resp;
-  unsigned char *bufp, *m1p, *m2p;
-  SEXP res;
   PROTECT(buf = AS_RAW(buf));
   PROTECT(m1 = AS_RAW(m1));
   PROTECT(m2 = AS_RAW(m2));
   PROTECT(demand_sequential = AS_INTEGER(demand_sequential));
-  bufp = RAW_POINTER(buf);
-  m1p = RAW_POINTER(m1);
-  m2p = RAW_POINTER(m2);
-  ds = *INTEGER(demand_sequential);
-  n = LENGTH(buf);
-  unsigned short seq_last=0, seq_this;
-  // Rprintf("demand_sequential=%d\n",ds);
-  int nnn=10;
-
-  /* FIXME: the two passes repeat too much code, and should be done as a subroutine */
-
-  //
-  // Pass 1: allocate vector
-  //
-  n_match = 0;                  /* don't demand anything at start */
-  for (i = 0; i < n - 1; i++) {
-    if (bufp[i] == *m1p && bufp[i + 1] == *m2p) {
-      if (ds) {
-        seq_this = (((unsigned short)bufp[i + 3]) << 8) | (unsigned short)bufp[i + 2];
-        // if (nnn > 0) Rprintf("i=%d seq_this=%d seq_last=%d ... ",i,seq_this,seq_last);
-        if (!n_match || (seq_this == (seq_last + 1)) || (seq_this == 1 && seq_last == 65535)) { /* is second needed, given short type? */
-          n_match++;
-          ++i;   // skip
-          seq_last = seq_this;
-          // if (nnn > 0) Rprintf("KEEP\n");
-        } else {
-          // if (nnn > 0) Rprintf("DISCARD\n");
-        }
-        //nnn--;
+  unsigned char *bufp = RAW_POINTER(buf);
+  unsigned char pat[3];
+  pat[0] = *RAW_POINTER(m1);
+  pat[1] = *RAW_POINTER(m2);
+  pat[2] = 0;
+  int ds = *INTEGER(demand_sequential);
+  R_xlen_t n = XLENGTH(buf);
+  find_bytes_t find_bytes = choose_find_bytes();
+  match_list m;
+  m.n = 0;
+  m.size = 1024;
+  m.v = R_Calloc(m.size, double);
+  unsigned short seq_last = 0, seq_this;
+  R_xlen_t i = 0;
+  while ((i = find_bytes(bufp, n, pat, 2, i)) >= 0) {
+    if (ds) {
+      /* A match too near the end has no sequence number */
+      seq_this = i + 3 < n ? (((unsigned short)bufp[i + 3]) << 8) | (unsigned short)bufp[i + 2] : 0;
+      if (!m.n || (i + 3 < n && ((seq_this == (seq_last + 1)) || (seq_this == 1 && seq_last == 65535)))) {
+        match_list_push(&m, (double)(i + 1)); /* the 1 is to offset from C to R */
+        seq_last = seq_this;
+        i += 2;
       } else {
-        n_match++;
-        ++i;   // skip
+        i++;
       }
+    } else {
+      match_list_push(&m, (double)(i + 1)); /* the 1 is to offset from C to R */
+      i += 2;
     }
   }
-  //
-  // Pass 2: fill in the vector 
-  //
-  PROTECT(res = NEW_NUMERIC(n_match));
-  resp = NUMERIC_POINTER(res);
-  j = 0;
-  seq_last = 0;
-  nnn = 1000;
-  //Rprintf("PASS 2\n");
-  n_match = 0;                  /* don't demand anything at start */
-  for (i = 0; i < n - 1; i++) {
-    //    Rprintf("[%d]:", i);
-    if (bufp[i] == *m1p && bufp[i + 1] == *m2p) {
-      if (ds) {
-        seq_this = (((unsigned short)bufp[i + 3]) << 8) | (unsigned short)bufp[i + 2];
-        //if (nnn > 0) Rprintf("i=%d seq_this=%d seq_last=%d ... ",i,seq_this,seq_last);
-        if (!n_match || (seq_this == (seq_last + 1)) || (seq_this == 1 && seq_last == 65535)) { /* is second needed, given short type? */
-          n_match++;
-          resp[j++] = i + 1; /* the 1 is to offset from C to R */
-          ++i;   /* skip */
-          seq_last = seq_this;
-          //if (nnn > 0) Rprintf("KEEP\n");
-        } else {
-          //if (nnn > 0) Rprintf("DISCARD\n");
-        }
-        nnn--;
-      } else {
-        resp[j++] = i + 1; /* the 1 is to offset from C to R */
-        ++i;   /* skip */
-      }
-    }
-  }
-  UNPROTECT(5);
-  return(res);
+  UNPROTECT(4);
+  return(match_list_result(&m));
 }
 
 /* NEW */
@@ -376,53 +636,30 @@ SEXP locate_vector_imu_sequences(SEXP buf)
 
 
      */
-  PROTECT(buf = AS_RAW(buf));
-  unsigned char *bufp;
-  bufp = RAW_POINTER(buf);
-  int bufn = LENGTH(buf);
-  SEXP res;
-  PROTECT(res = NEW_INTEGER(bufn)); // definitely more than enough space
-  int *resp = INTEGER_POINTER(res);
-  int resn = 0;
-  //int check=10; // check this many instance of 0xa5,0x71
-  // We check 5 bytes, on the assumption that false positives will be
-  // effectively zero then (1e-12, if independent random numbers
-  // in range 0 to 255).
-  // FIXME: test the checksum, but SIG2 does not state how.
-  for (int i = 0; i < bufn-1; i++) {
-    if (bufp[i] == 0xa5 && bufp[i+1] == 0x71) {
-      //if (check-- > 0) Rprintf("IMU test: buf[%d]=0x%02x, buf[%d+2]=0x%02x, buf[%d+5]=0x%02x\n", i, bufp[i], i, bufp[i+2], i, bufp[i+5]);
-      // Check at offset=5, which must be 1 of 3 choices.
-      if (bufp[i+5] == 0xc3) {
-        // FIXME: should verify this length check, which I got by inspecting dolfyn code
-        // and a file provided privately in March 2016.
-        if (bufp[i+2] == 0x24 && bufp[i+3] == 0x00) {
-          resp[resn++] = i + 1; // add 1 for R notation
-          i++; //FIXME: skip to end, when we really trust identification
-        }
-      } else if (bufp[i+5] == 0xcc) {
-        // length indication should be 0x2b=43=86/2 (SIG2, top of page 31)
-        if (bufp[i+2] == 0x2b && bufp[i+3] == 0x00) {
-          resp[resn++] = i + 1; // add 1 for R notation
-          i++; //FIXME: skip to end, when we really trust identification
-        }
-      } else if (bufp[i+5] == 0xd2) { // decimal 210
-        // length indication should be 0x19=25=50/2 (SIG2, middle of page 31)
-        if (bufp[i+2] == 0x19 && bufp[i+3] == 0x00) {
-          resp[resn++] = i + 1; // add 1 for R notation
-          i++; //FIXME: skip to end, when we really trust identification
-        }
-      } else if (bufp[i+5] ==0xd3) { // decimal 211
-        // length indication should be 0x19=25=50/2 (SIG2, page 32)
-        if (bufp[i+2] == 0x19 && bufp[i+3] == 0x00) {
-          resp[resn++] = i + 1; // add 1 for R notation
-          i++; //FIXME: skip to end, when we really trust identification
-        }
-      }
-    }
+  /* The bytes at offsets 2 and 3 hold the record length (in 2-byte
+   * words), which is checked against the expected value for each
+   * type. FIXME: test the checksum, but SIG2 does not state how. */
+  static const unsigned char types[4] = {0xc3, 0xcc, 0xd2, 0xd3};
+  /* c3: inferred from dolfyn code and a file provided privately in March 2016
+   * cc: 0x2b=43=86/2 (SIG2, top of page 31)
+   * d2: 0x19=25=50/2 (SIG2, middle of page 31)
+   * d3: 0x19=25=50/2 (SIG2, page 32) */
+  static const int lengths[4] = {72, 86, 50, 50};
+  record_rule rules[4];
+  for (int k = 0; k < 4; k++) {
+    record_rule_init(&rules[k]);
+    rules[k].sync[0] = 0xa5;
+    rules[k].sync[1] = 0x71;
+    rules[k].nsync = 2;
+    rules[k].length = lengths[k];
+    rules[k].length_offset = 2;
+    rules[k].length_unit = 2;
+    rules[k].id_offset = 5;
+    rules[k].id = types[k];
   }
-  SET_LENGTH(res, resn);
-  UNPROTECT(2);
+  PROTECT(buf = AS_RAW(buf));
+  SEXP res = locate_records_of_types(buf, rules, 4, 0);
+  UNPROTECT(1);
   return(res);
 }
 
@@ -453,107 +690,57 @@ SEXP locate_byte_sequences(SEXP buf, SEXP match, SEXP len, SEXP key, SEXP max)
      print(s)
      print(vvd.start)
      */
-  unsigned char *pbuf, *pmatch, *pkey;
   PROTECT(buf = AS_RAW(buf));
   PROTECT(match = AS_RAW(match));
   PROTECT(len = AS_INTEGER(len));
   PROTECT(key = AS_RAW(key));
   PROTECT(max = AS_INTEGER(max));
-  /* FIXME: check lengths of match and key */
-  pbuf = RAW_POINTER(buf);
-  pmatch = RAW_POINTER(match);
-  pkey = RAW_POINTER(key);
-  int lsequence = *INTEGER_POINTER(len);
-  int max_lres = *INTEGER_POINTER(max);
-#ifdef DEBUG
-  Rprintf("lsequence=%d\n",lsequence);
-#endif
+  unsigned char *pmatch = RAW_POINTER(match);
+  unsigned char *pkey = RAW_POINTER(key);
   int lmatch = LENGTH(match);
-  int lbuf = LENGTH(buf);
-  int lkey = LENGTH(key);
-  if (lkey != 2) error("key length must be 2");
-  int ires = 0, lres = (int)(lbuf / lsequence + 3); /* get some extra space; fill some with NA */
-  SEXP res;
-#ifdef DEBUG
-  Rprintf("lsequence=%d, lres=%d\n",lsequence,lres);
-#endif
-  /* Rprintf("max_lres=%d\n", max_lres); */
-  if (max_lres > 0)
-    lres = max_lres;
-  PROTECT(res = NEW_INTEGER(lres));
-  int *pres = INTEGER_POINTER(res);
-  /* Count matches, so we can allocate the right length */
-  short lsequence2 = lsequence / 2;
-  for (int i = 0; i < lbuf - lsequence; i++) {
-    short check_value = (((short)pkey[0]) << 8) | (short)pkey[1];
-    int found = 0;
-    for (int m = 0; m < lmatch; m++) {
-      if (pbuf[i+m] == pmatch[m]) 
-        found++;
-      else
-        break;
-    }
-    if (found == lmatch) {
-      /* FIXME: should bit-twiddle this to work on all endian types */
-      short *check = (short*)(pbuf+i);
-      /*Rprintf(" %d", check_value);*/
-      for (int cc = 0; cc < lsequence2 - 1; cc++) { /* last 2-byte chunk is the test value */
-        check_value += *check++;
-        /*Rprintf(" %d", check_value);*/
-      }
-      short check_sum = (((short)pbuf[i+lsequence-1]) << 8) | (short)pbuf[i+lsequence-2];
-#ifdef DEBUG
-      Rprintf("i=%d lbuf=%d ires=%d  lres=%d  check_value=%d vs check_sum %d match=%d\n", i, lbuf, ires, lres, check_value, check_sum, check_value==check_sum);
-#endif
-      if (check_value == check_sum) {
-        pres[ires++] = i + 1;
-        i += lsequence - lmatch; /* no need to check within sequence */
-      }
-      if (ires >= lres)
-        break;
-    }
-    i += lmatch - 1;           /* skip over matched bytes */
-    if (i > (lbuf - lsequence)) 
-      break; /* FIXME: can this ever happen? */
-  }
-  SET_LENGTH(res, ires);
-  UNPROTECT(6);
+  if (LENGTH(key) != 2) error("key length must be 2");
+  if (lmatch < 1 || lmatch > RECORD_SYNC_MAX) error("match length must be between 1 and %d", RECORD_SYNC_MAX);
+  int max_lres = *INTEGER_POINTER(max);
+  record_rule rule;
+  record_rule_init(&rule);
+  memcpy(rule.sync, pmatch, lmatch);
+  rule.nsync = lmatch;
+  rule.length = *INTEGER_POINTER(len);
+  rule.checksum = RECORD_CHECKSUM_NORTEK;
+  rule.seed = (unsigned short)((pkey[0] << 8) | pkey[1]);
+  SEXP res = locate_records(buf, &rule, max_lres > 0 ? max_lres : 0);
+  UNPROTECT(5);
   return(res);
 }
 
+/*
+ * Find (non-overlapping) locations of a three-byte sequence in a
+ * buffer, returning the R-style (i.e. starting at 1) indices.
+ */
 SEXP match3bytes(SEXP buf, SEXP m1, SEXP m2, SEXP m3)
 {
-  int i, j, n, n_match;
-  double *resp;
-  unsigned char *bufp, *m1p, *m2p, *m3p;
-  SEXP res;
   PROTECT(buf = AS_RAW(buf));
   PROTECT(m1 = AS_RAW(m1));
   PROTECT(m2 = AS_RAW(m2));
   PROTECT(m3 = AS_RAW(m3));
-  bufp = RAW_POINTER(buf);
-  m1p = RAW_POINTER(m1);
-  m2p = RAW_POINTER(m2);
-  m3p = RAW_POINTER(m3);
-  n = LENGTH(buf);
-  n_match = 0;
-  for (i = 0; i < n - 2; i++) {
-    if (bufp[i] == *m1p && bufp[i + 1] == *m2p && bufp[i + 2] == *m3p) {
-      n_match++;
-      ++i;   /* skip */
-      ++i;   /* skip */
-    }
-  }
-  PROTECT(res = NEW_NUMERIC(n_match));
-  resp = NUMERIC_POINTER(res);
-  j = 0;
-  for (i = 0; i < n - 2; i++) {
-    if (j <= n_match && bufp[i] == *m1p && bufp[i + 1] == *m2p && bufp[i + 2] == *m3p) {
-      resp[j++] = i + 1; /* the 1 is to offset from C to R */
-    }
+  unsigned char *bufp = RAW_POINTER(buf);
+  unsigned char pat[3];
+  pat[0] = *RAW_POINTER(m1);
+  pat[1] = *RAW_POINTER(m2);
+  pat[2] = *RAW_POINTER(m3);
+  R_xlen_t n = XLENGTH(buf);
+  find_bytes_t find_bytes = choose_find_bytes();
+  match_list m;
+  m.n = 0;
+  m.size = 1024;
+  m.v = R_Calloc(m.size, double);
+  R_xlen_t i = 0;
+  while ((i = find_bytes(bufp, n, pat, 3, i)) >= 0) {
+    match_list_push(&m, (double)(i + 1)); /* the 1 is to offset from C to R */
+    i += 3;
   }
-  UNPROTECT(5);
-  return(res);
+  UNPROTECT(4);
+  return(match_list_result(&m));
 }
 
 // create (*n) unsigned 16-bit little-endian int values from 2*(*n) bytes, e.g.
@@ -1,70 +1,39 @@
 /* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
 
 #include <Rcpp.h>
+#include <vector>
 using namespace Rcpp;
 
-// FIXME 1: think about whether this saved-storage is thread-safe, and
-// also whether we may need to resize (are all pings created equal?)
-//
-// FIXME 2: this code should be altered to handle dual- and split-beam
-// data.  In single-beam data, the procedure is to work in 2-byte
-// chunks (as is done here) but for the other cases, it should work in
-// 4-byte chunks.
+// Single-beam pings hold 2 bytes per sample, while dual-beam and
+// split-beam pings hold 4 bytes per sample [1 sec 4.9].
 //
 // REFERENCES:
 // [1] "DT4 Data File Format Specification" [July, 2010] DT4_format_2010.pdf
 
 //#define DEBUG 1
 
-// 1. Routines to maintain static storage to avoid possibly thousands
-// of allocations of identical size (are we sure on that?, for a fixed purpose.
-// FIXME: see if OK on multicore; if not, use R method (if that's ok).
-static unsigned char *buffer = NULL; // single-beam uses just first 2 bytes of each 4-byte entry
-void biosonics_allocate_storage(int spp, int byte_per_sample)
-{
-  if (buffer == NULL) {
-#ifdef DEBUG
-    Rprintf("should allocate space for %d data now\n", spp * byte_per_sample);
-#endif
-    buffer = (unsigned char*)calloc(spp * byte_per_sample, sizeof(unsigned char));
-    if (buffer == NULL) {
-      ::Rf_error("cannot allocate space for temporary buffer, of length %d bytes", spp * byte_per_sample);
-    }
-#ifdef DEBUG
-    Rprintf("... allocation was OK; address is %lx\n", buffer);
-#endif
-  }
-}
-
-extern "C" {
-void biosonics_free_storage()
-{
-#ifdef DEBUG
-    Rprintf("freeing up 'buffer' storage at address %lx\n", buffer);
-#endif
-  if (buffer != NULL)
-    free(buffer);
-  buffer = NULL;
-}
-}
+// 1. Scratch storage. Each ping is run-length expanded into a buffer
+// of spp*byte_per_sample bytes that is supplied by the caller, so
+// that several pings may be decoded at once, in different threads.
+// (Formerly, a file-static buffer was used, which prevented that.)
 
 // 2. run-length expansion
-void rle(unsigned char *samp, int ns, int spp, int byte_per_sample)
+void rle(const unsigned char *samp, int ns, int spp, int byte_per_sample, unsigned char *buffer)
 {
   // This code is patterned on [1 p36-37] for runlength expansion
   // of data stored in 4-byte chunks.  The main difference is
   // that the present function uses bytewise operations, which
   // means that it should work the same on big-endian
   // and little-endian computers.  After this function returns,
-  // the global-storage 'buffer' contains runlength expanded
-  // data taken from the 'samp', and the length of that buffer
-  // is 4*spp bytes.
+  // 'buffer' contains runlength expanded data taken from the
+  // 'samp', and the length of that buffer is
+  // spp*byte_per_sample bytes.
 #ifdef DEBUG
   Rprintf("rle(0x%02x%02x%02x%02x ..., ns=%d, spp=%d, byte_per_sample=%d)\n",
       samp[0], samp[1], samp[2], samp[3], ns, spp, byte_per_sample);
 #endif
   int i = 0, k = 0;
-  unsigned char b1, b2, b3, b4;
+  unsigned char b1, b2, b3 = 0, b4 = 0;
   int NS = ns * byte_per_sample;
   int SPP = spp * byte_per_sample;
   while (i < NS) {
@@ -119,7 +88,6 @@ void rle(unsigned char *samp, int ns, int spp, int byte_per_sample)
   }
 }
 
-
 // 3. subsecond time for Biosonic echosounder [1 p19], wrapped
 // as C for use in R/echosounder.R.
 extern "C" {
@@ -150,62 +118,156 @@ double biosonic_float(unsigned char byte1, unsigned char byte2)
     return((double)res);
 }
 
-// Cross-reference work:
-// 1. update ../src/registerDynamicSymbol.c with an item for this
-// 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
-// [[Rcpp::export]]
-List do_biosonics_ping(RawVector bytes, NumericVector Rspp, NumericVector Rns, NumericVector Rtype)
+// 5. decode a ping, storing sample k in a[k*stride], b[k*stride] and
+// c[k*stride]. A negative stride reverses the order of samples. The
+// 'buffer' must hold 4*spp bytes. This does not call R functions, so
+// it may be used in several threads at once.
+static void biosonics_decode(const unsigned char *bytes, int ns, int spp, int type,
+    unsigned char *buffer, double *a, double *b, double *c, R_xlen_t stride)
 {
-  int spp = (int)floor(0.5 + Rspp[0]);
-  int ns = (int)floor(0.5 + Rns[0]);
-  int type = (int)floor(0.5 + Rtype[0]); // beam type
-#ifdef DEBUG
-  Rprintf("biosonics_ping() decoded type:%d, spp:%d, ns:%d\n", type, spp, ns);
-#endif
-  int byte_per_sample = 2;
-  if (type == 1 || type == 2) {
-    byte_per_sample = 4;
-  }
-  NumericVector a(spp);
-  NumericVector b(spp);
-  NumericVector c(spp);
-
-  // Get static storage; FIXME: is this thread-safe?
-  biosonics_allocate_storage(spp, byte_per_sample);
   if (type == 0) { // single-beam
-    rle((unsigned char*)&bytes[0], ns, spp, 2);
+    rle(bytes, ns, spp, 2, buffer);
     for (int k = 0; k < spp; k++) {
-      a[k] = biosonic_float(buffer[byte_per_sample * k], buffer[1 + byte_per_sample * k]);
-      b[k] = 0.0;
-      c[k] = 0.0;
+      a[k * stride] = biosonic_float(buffer[2 * k], buffer[1 + 2 * k]);
+      b[k * stride] = 0.0;
+      c[k * stride] = 0.0;
     }
   } else if (type == 1) { // dual-beam
-    rle((unsigned char*)&bytes[0], ns, spp, 4);
+    rle(bytes, ns, spp, 4, buffer);
     for (int k = 0; k < spp; k++) {
       // Quote [1 p37 re dual-beam]: "For an RLE-expanded sample x, the low-order
       // word (ie, (USHORT)(x & 0x0000FFFF)) contains the narrow-beam data. The
       // high-order word (ie, (USHORT)((x & 0xFFFF0000) >> 16)) contains the
       // wide beam data."
-      a[k] = biosonic_float(buffer[    byte_per_sample * k], buffer[1 + byte_per_sample * k]);
-      b[k] = biosonic_float(buffer[2 + byte_per_sample * k], buffer[3 + byte_per_sample * k]);
-      b[k] = 0.0;
+      a[k * stride] = biosonic_float(buffer[4 * k], buffer[1 + 4 * k]);
+      b[k * stride] = biosonic_float(buffer[2 + 4 * k], buffer[3 + 4 * k]);
+      c[k * stride] = 0.0;
     }
-  } else if (type == 2) { // split-beam
-    rle((unsigned char*)&bytes[0], ns, spp, 4);
+  } else { // split-beam
+    rle(bytes, ns, spp, 4, buffer);
     for (int k = 0; k < spp; k++) {
       // Quote [1 p38 split-beam e.g. 01-Fish.dt4 example]: "the low-order word
       // (ie, (USHORT)(x & 0x0000FFFF)) contains the amplitude data. The
       // high-order byte (ie, (TINY)((x & 0xFF000000) >> 24)) contains the
       // raw X-axis angle data. The other byte
       // (ie, (TINY)((x & 0x00FF0000) >> 16)) contains the raw Y-axis angle data.
-      a[k] = biosonic_float(buffer[byte_per_sample * k], buffer[1 + byte_per_sample * k]);
-      b[k] = (double)buffer[2 + byte_per_sample * k];
-      c[k] = (double)buffer[3 + byte_per_sample * k];
+      // Note that TINY is a signed type.
+      a[k * stride] = biosonic_float(buffer[4 * k], buffer[1 + 4 * k]);
+      b[k * stride] = (double)(signed char)buffer[3 + 4 * k];
+      c[k * stride] = (double)(signed char)buffer[2 + 4 * k];
     }
-  } else {
+  }
+}
+
+// Cross-reference work:
+// 1. update ../src/registerDynamicSymbol.c with an item for this
+// 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
+// [[Rcpp::export]]
+List do_biosonics_ping(RawVector bytes, NumericVector Rspp, NumericVector Rns, NumericVector Rtype)
+{
+  int spp = (int)floor(0.5 + Rspp[0]);
+  int ns = (int)floor(0.5 + Rns[0]);
+  int type = (int)floor(0.5 + Rtype[0]); // beam type
+#ifdef DEBUG
+  Rprintf("biosonics_ping() decoded type:%d, spp:%d, ns:%d\n", type, spp, ns);
+#endif
+  if (type < 0 || type > 2)
     ::Rf_error("unknown type, %d", type);
+  NumericVector a(spp);
+  NumericVector b(spp);
+  NumericVector c(spp);
+  if (spp > 0) {
+    std::vector<unsigned char> buffer(4 * (size_t)spp);
+    biosonics_decode((unsigned char*)&bytes[0], ns, spp, type, &buffer[0], &a[0], &b[0], &c[0], 1);
   }
   return(List::create(Named("a")=a, Named("b")=b, Named("c")=c));
 }
 
+/*
+
+Decode BioSonics pings
+
+@description
+
+Decode all the pings in a DT4 file in one call, instead of calling
+do_biosonics_ping() for each ping. The pings are independent, so they
+are decoded in parallel if 'nthreads' exceeds 1 and the package was
+compiled with OpenMP support; each thread has its own scratch buffer
+for the run-length expansion.
+
+@param buf raw vector holding the whole file.
 
+@param offset numeric vector holding the locations within 'buf' of
+the sample data of the pings, counting from 0; this is 16 bytes past
+the start of the ping tuple [1 sec 4.9].
+
+@param ns integer vector holding the number of (run-length encoded)
+samples in each ping.
+
+@param type integer vector holding the beam type of each ping, 0 for
+single-beam, 1 for dual-beam, or 2 for split-beam.
+
+@param spp integer giving the number of samples per ping, after
+run-length expansion.
+
+@param nthreads integer giving the number of threads to use.
+
+@value a list holding matrices named "a", "b" and "c", each with one
+row per ping and spp columns, with samples in reverse order, i.e.
+row i of "a" equals rev(do_biosonics_ping(...)$a) for ping i. For
+single-beam pings, "a" is amplitude, and "b" and "c" are zero. For
+dual-beam pings, "a" is the narrow-beam amplitude, "b" is the
+wide-beam amplitude, and "c" is zero. For split-beam pings, "a" is
+amplitude, while "b" and "c" are the raw x-axis and y-axis angles,
+which are signed 1-byte values [1 p38].
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_biosonics_pings(RawVector buf, NumericVector offset, IntegerVector ns,
+    IntegerVector type, IntegerVector spp, IntegerVector nthreads)
+{
+  R_xlen_t N = offset.size();
+  int spp_value = spp[0];
+  int nthreads_value = nthreads[0] < 1 ? 1 : nthreads[0];
+  if (ns.size() != N || type.size() != N)
+    ::Rf_error("'offset', 'ns' and 'type' must have equal lengths");
+  if (spp_value < 0)
+    ::Rf_error("'spp' must be non-negative, but it is %d", spp_value);
+  // Check the pings before decoding, since errors cannot be reported
+  // from within threads.
+  R_xlen_t nbuf = buf.size();
+  for (R_xlen_t i = 0; i < N; i++) {
+    if (type[i] < 0 || type[i] > 2)
+      ::Rf_error("unknown type, %d, for ping %ld", type[i], (long)(i+1));
+    double need = (double)ns[i] * (type[i] == 0 ? 2 : 4);
+    if (offset[i] < 0 || ns[i] < 0 || offset[i] + need > nbuf)
+      ::Rf_error("ping %ld (at offset %.0f, with %d samples) extends past the end of the buffer",
+          (long)(i+1), offset[i], ns[i]);
+  }
+  NumericMatrix a(N, spp_value), b(N, spp_value), c(N, spp_value);
+  if (N > 0 && spp_value > 0) {
+    const unsigned char *p = (const unsigned char *)&buf[0];
+    double *pa = &a[0], *pb = &b[0], *pc = &c[0];
+    // Start each row at the last column, and step backwards, to
+    // reverse the order of samples.
+    R_xlen_t last = N * (R_xlen_t)(spp_value - 1);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads_value)
+#endif
+    {
+      std::vector<unsigned char> buffer(4 * (size_t)spp_value);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (R_xlen_t i = 0; i < N; i++)
+        biosonics_decode(p + (R_xlen_t)offset[i], ns[i], spp_value, type[i], &buffer[0],
+            pa + i + last, pb + i + last, pc + i + last, -N);
+    }
+  }
+  return(List::create(Named("a")=a, Named("b")=b, Named("c")=c));
+}
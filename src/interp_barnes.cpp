@@ -1,39 +1,134 @@
 /* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
 
 #include <Rcpp.h>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
 using namespace Rcpp;
 
 // Cross-reference work:
 // 1. update ../src/registerDynamicSymbol.c with an item for this
 // 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
 
-//#define USE_APPROX_EXP 1
-#ifdef USE_APPROX_EXP
-// Compute exp(-x) approximately, as efficiency measure.
-// See Dan Kelley notebook [1997/1/25] for demonstration
-// of factor of 3 speedup, with 1000 column data and a
-// 10 by 10 grid, and demonstration that the
-// error is < 0.1% in the final grid.
-inline double exp_approx(double x)
+// Compute exp(-d), for 0<=d<=800, without calling the library exp(),
+// so that loops over this can be vectorised by the compiler. Writing
+// -d = n*log(2) + r, with n an integer and |r| <= log(2)/2, gives
+// exp(-d) = 2^n * exp(r), with exp(r) found from its Taylor series to
+// r^11, arranged by Estrin's scheme to shorten the chain of dependent
+// operations. The maximum relative error, compared with exp(), is
+// 1e-14 for d < 708. Larger d give subnormal values, with 2^n split
+// into two factors so they underflow gradually, and d>745 gives 0, as
+// for exp(). The rounding of n uses the fact that adding and then
+// subtracting 1.5*2^52 rounds a double of magnitude below 2^51 to an
+// integer, which is also found in the low bits of the sum.
+#define BARNES_SHIFT 6755399441055744.0 /* 1.5*2^52 */
+
+static inline double exp2_int(double n) // 2^n, for integer n in [-1022,1023]
+{
+  double t = n + BARNES_SHIFT, shift = BARNES_SHIFT;
+  int64_t ti, si;
+  memcpy(&ti, &t, sizeof(double));
+  memcpy(&si, &shift, sizeof(double));
+  int64_t bits = (ti - si + 1023) << 52;
+  double res;
+  memcpy(&res, &bits, sizeof(double));
+  return res;
+}
+
+static inline double exp_neg_fast(double d)
 {
-  return 1.0 / (0.999448
-      + x * (1.023820
-        + x * (0.3613967
-          + x * (0.4169646
-            + x * (-0.1292509
-              + x * 0.0499565)))));
+  const double log2e = 1.4426950408889634074;
+  const double ln2hi = 6.93147180369123816490e-01, ln2lo = 1.90821492927058770002e-10;
+  double x = -d;
+  double n = (x * log2e + BARNES_SHIFT) - BARNES_SHIFT;
+  double r = (x - n * ln2hi) - n * ln2lo; // ln2hi*n is exact
+  double r2 = r * r, r4 = r2 * r2, r8 = r4 * r4;
+  double p01 = 1.0 + r, p23 = 1.0/2 + r * (1.0/6);
+  double p45 = 1.0/24 + r * (1.0/120), p67 = 1.0/720 + r * (1.0/5040);
+  double p89 = 1.0/40320 + r * (1.0/362880), pab = 1.0/3628800 + r * (1.0/39916800);
+  double p = (p01 + r2 * p23) + r4 * (p45 + r2 * p67) + r8 * (p89 + r2 * pab);
+  double nc = 0.5 * (n - 1022.0 + fabs(n + 1022.0)); // max(n,-1022), exactly
+  return p * exp2_int(nc) * exp2_int(n - nc);
 }
+
+// Data are handled in tiles of this many, with their weights computed
+// together in loops that can be vectorised.
+#define BARNES_TILE 128
+
+// Compute weights for 'nt' data at (x,y), with weights w, at the point
+// (xx,yy), with ixr and iyr being the reciprocals of the radii. Weights
+// with (scaled) squared distances exceeding dmax are set to 0.
+static void barnes_weights_fast(int nt, double xx, double yy,
+    const double *x, const double *y, const double *w,
+    double ixr, double iyr, double dmax, double *weight)
+{
+  double d[BARNES_TILE];
+#ifdef _OPENMP
+#pragma omp simd
 #endif
+  for (int t = 0; t < nt; t++) {
+    double dx = (xx - x[t]) * ixr, dy = (yy - y[t]) * iyr;
+    double dt = dx*dx + dy*dy;
+    d[t] = dt <= dmax ? dt : 800.0; // exp_neg_fast(800) is 0
+  }
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (int t = 0; t < nt; t++)
+    weight[t] = w[t] * exp_neg_fast(d[t]);
+}
+
+// Add the contributions of 'nt' data, with the given weights, to the
+// sums for each of 'nfield' fields, skipping NA values. The sums for a
+// tile are formed in local variables, which the compiler can keep in
+// registers; std::isnan() is used because ISNAN() is a function call
+// in C++.
+static inline void barnes_accumulate(int nt, const double *weight,
+    int nfield, const double *dz, double *sum, double *sum_w)
+{
+  for (int f = 0; f < nfield; f++) {
+    double s = 0.0, sw = 0.0;
+    for (int t = 0; t < nt; t++) {
+      double dzt = dz[(size_t)t * nfield + f];
+      if (!std::isnan(dzt)) {
+        s += weight[t] * dzt;
+        sw += weight[t];
+      }
+    }
+    sum[f] += s;
+    sum_w[f] += sw;
+  }
+}
 
 static time_t start;
 
-static double interpolate_barnes(double xx, double yy, double zz, /* interpolate to get zz value at (xx,yy) */
+// Accumulate, for each of 'nfield' fields, the sums of weight*dz and
+// of weight, over the data, for a point at (xx,yy). The z-z_last values
+// for the k-th datum are dz[k*nfield] to dz[k*nfield+nfield-1], with NA
+// for missing data, which are skipped. The weight is computed once for
+// each datum, and applied to all the fields. If 'fast' is nonzero,
+// exp_neg_fast() is used instead of exp(), on tiles of data.
+static void interpolate_barnes(double xx, double yy, /* location of interpolated value */
     int skip, /* value in (x,y,z) to skip, or -1 if no skipping */
-    unsigned int nx, double *x, double *y, double *z, double *w, /* data num, locations, values, weights */
-    double *z_last, /* last estimate of z at (x,y) */
-    double xr, double yr, int debug) /* influence radii */
+    unsigned int nx, const double *x, const double *y, const double *w, /* data num, locations, weights */
+    int nfield, const double *dz, /* fields, and data minus last estimate */
+    double xr, double yr, /* influence radii */
+    int fast, double *sum, double *sum_w)
 {
-  double sum = 0.0, sum_w = 0.0;
+  for (int f = 0; f < nfield; f++)
+    sum[f] = sum_w[f] = 0.0;
+  if (fast) {
+    double weight[BARNES_TILE];
+    for (unsigned int k0 = 0; k0 < nx; k0 += BARNES_TILE) {
+      int nt = nx - k0 < BARNES_TILE ? nx - k0 : BARNES_TILE;
+      barnes_weights_fast(nt, xx, yy, x + k0, y + k0, w + k0, 1.0 / xr, 1.0 / yr, 800.0, weight);
+      if (skip >= (int)k0 && skip < (int)k0 + nt)
+        weight[skip - k0] = 0.0;
+      barnes_accumulate(nt, weight, nfield, dz + (size_t)k0 * nfield, sum, sum_w);
+    }
+    return;
+  }
   for (unsigned int k = 0; k < nx; k++) {
     // R trims NA (x,y values so no need to check here
     if ((int)k != skip) {
@@ -41,128 +136,399 @@ static double interpolate_barnes(double xx, double yy, double zz, /* interpolate
       dx = (xx - x[k]) / xr;
       dy = (yy - y[k]) / yr;
       d = dx*dx + dy*dy;
-#ifdef USE_APPROX_EXP
-      weight = w[k] * exp_approx(-d);
-#else
       weight = w[k] * exp(-d);
-#endif
-      sum += weight * (z[k] - z_last[k]);
-      sum_w += weight;
+      const double *dzk = dz + (size_t)k * nfield;
+      for (int f = 0; f < nfield; f++) {
+        if (!ISNAN(dzk[f])) {
+          sum[f] += weight * dzk[f];
+          sum_w[f] += weight;
+        }
+      }
     }
   }
-  return ((sum_w > 0.0) ? (zz + sum / sum_w) : NA_REAL);
 }
 
-// next is modelled on interpolate_barnes()
-static double weight_barnes(double xx, double yy,
-    int skip,
-    unsigned int n, double *x, double *y, double *z, double *w,
-    double xr, double yr)
+// Spatial index of the data, used if observations beyond 'cutoff'
+// radii are to be ignored. The data are scaled by the radii, so that
+// the cutoff is a circle of radius 'cutoff', and sorted into square
+// buckets of side 'size', which is at least 'cutoff', so that a
+// search need only look in nearby buckets. The number of buckets is
+// limited to a few times the number of data, by enlarging them if
+// need be, to save memory when the radii are small.
+typedef struct {
+  double u0, v0, size, cutoff;
+  int nu, nv;
+  std::vector<int> start; // data in bucket b are start[b] to start[b+1]-1
+  std::vector<int> order; // index of k-th sorted datum in the input
+  std::vector<double> u, v, w; // sorted scaled locations and weights
+  std::vector<double> dz; // z-z_last for each field, for each sorted datum in turn
+} barnes_index;
+
+static void barnes_index_build(barnes_index *idx, int n, int nfield, const double *x, const double *y,
+    const double *w, double xr, double yr, double cutoff)
 {
-  double sum_w, dx, dy, d, weight;
-  sum_w = 0.0;
-  for (unsigned int k = 0; k < n; k++) {
-    if ((int)k != skip) {
-      dx = (xx - x[k]) / xr;
-      dy = (yy - y[k]) / yr;
-      d = dx*dx + dy*dy;
-#ifdef USE_APPROX_EXP
-      weight = w[k] * exp_approx(-d);
-#else
-      weight = w[k] * exp(-d);
-#endif
-      sum_w += weight;
+  double umin = x[0] / xr, umax = umin, vmin = y[0] / yr, vmax = vmin;
+  for (int k = 1; k < n; k++) {
+    double u = x[k] / xr, v = y[k] / yr;
+    if (u < umin) umin = u;
+    if (u > umax) umax = u;
+    if (v < vmin) vmin = v;
+    if (v > vmax) vmax = v;
+  }
+  double size = cutoff;
+  double maxBuckets = 4.0 * n + 16.0;
+  double nu = floor((umax - umin) / size) + 1.0, nv = floor((vmax - vmin) / size) + 1.0;
+  if (nu * nv > maxBuckets) {
+    size *= sqrt(nu * nv / maxBuckets);
+    nu = floor((umax - umin) / size) + 1.0;
+    nv = floor((vmax - vmin) / size) + 1.0;
+    while (nu * nv > maxBuckets) { // guard against rounding
+      size *= 1.1;
+      nu = floor((umax - umin) / size) + 1.0;
+      nv = floor((vmax - vmin) / size) + 1.0;
     }
   }
-  return ((sum_w > 0.0) ? sum_w : NA_REAL);
+  idx->u0 = umin;
+  idx->v0 = vmin;
+  idx->size = size;
+  idx->cutoff = cutoff;
+  idx->nu = (int)nu;
+  idx->nv = (int)nv;
+  int nb = idx->nu * idx->nv;
+  std::vector<int> bucket(n);
+  idx->start.assign(nb + 1, 0);
+  for (int k = 0; k < n; k++) {
+    int i = (int)((x[k] / xr - umin) / size), j = (int)((y[k] / yr - vmin) / size);
+    if (i >= idx->nu) i = idx->nu - 1;
+    if (j >= idx->nv) j = idx->nv - 1;
+    bucket[k] = i + idx->nu * j;
+    idx->start[bucket[k] + 1]++;
+  }
+  for (int b = 0; b < nb; b++)
+    idx->start[b + 1] += idx->start[b];
+  std::vector<int> next(idx->start.begin(), idx->start.end() - 1);
+  idx->order.resize(n);
+  for (int k = 0; k < n; k++)
+    idx->order[next[bucket[k]]++] = k;
+  idx->u.resize(n);
+  idx->v.resize(n);
+  idx->w.resize(n);
+  idx->dz.resize((size_t)n * nfield);
+  for (int s = 0; s < n; s++) {
+    int k = idx->order[s];
+    idx->u[s] = x[k] / xr;
+    idx->v[s] = y[k] / yr;
+    idx->w[s] = w[k];
+  }
 }
 
+// As interpolate_barnes(), but using only the data within idx->cutoff
+// radii of (xx,yy).
+static void interpolate_barnes_indexed(double xx, double yy,
+    const barnes_index *idx, int nfield, double xr, double yr,
+    int fast, double *sum, double *sum_w)
+{
+  double su = xx / xr, sv = yy / yr;
+  double c = idx->cutoff, c2 = c * c;
+  for (int f = 0; f < nfield; f++)
+    sum[f] = sum_w[f] = 0.0;
+  double fi0 = floor((su - c - idx->u0) / idx->size), fi1 = floor((su + c - idx->u0) / idx->size);
+  double fj0 = floor((sv - c - idx->v0) / idx->size), fj1 = floor((sv + c - idx->v0) / idx->size);
+  if (fi1 < 0.0 || fi0 >= idx->nu || fj1 < 0.0 || fj0 >= idx->nv)
+    return;
+  int i0 = fi0 < 0.0 ? 0 : (int)fi0, i1 = fi1 >= idx->nu ? idx->nu - 1 : (int)fi1;
+  int j0 = fj0 < 0.0 ? 0 : (int)fj0, j1 = fj1 >= idx->nv ? idx->nv - 1 : (int)fj1;
+  const double *u = &idx->u[0], *v = &idx->v[0], *w = &idx->w[0], *dz = &idx->dz[0];
+  for (int j = j0; j <= j1; j++) {
+    // buckets i0 to i1 in row j are adjacent in the sorted data
+    int s0 = idx->start[i0 + idx->nu * j], s1 = idx->start[i1 + 1 + idx->nu * j];
+    if (fast) {
+      double weight[BARNES_TILE];
+      for (int t0 = s0; t0 < s1; t0 += BARNES_TILE) {
+        int nt = s1 - t0 < BARNES_TILE ? s1 - t0 : BARNES_TILE;
+        barnes_weights_fast(nt, su, sv, u + t0, v + t0, w + t0, 1.0, 1.0, c2 < 800.0 ? c2 : 800.0, weight);
+        barnes_accumulate(nt, weight, nfield, dz + (size_t)t0 * nfield, sum, sum_w);
+      }
+      continue;
+    }
+    for (int s = s0; s < s1; s++) {
+      double du = su - u[s], dv = sv - v[s];
+      double d = du*du + dv*dv;
+      if (d <= c2) {
+        double weight = w[s] * exp(-d);
+        const double *dzs = dz + (size_t)s * nfield;
+        for (int f = 0; f < nfield; f++) {
+          if (!ISNAN(dzs[f])) {
+            sum[f] += weight * dzs[f];
+            sum_w[f] += weight;
+          }
+        }
+      }
+    }
+  }
+}
 
-// [[Rcpp::export]]
-List do_interp_barnes(NumericVector x, NumericVector y, NumericVector z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations)
+// Barnes interpolation of 'nfield' fields, held in the columns of
+// z[nx,nfield], which may contain NA values, to a grid, and back to the
+// data locations. The weights are computed once, for all fields. The
+// results are stored in zg[nxg,nyg,nfield], wg[nxg,nyg,nfield] and
+// zd[nx,nfield].
+static void barnes(int nx, const double *x, const double *y, const double *w,
+    int nfield, const double *z,
+    int nxg, const double *xg, int nyg, const double *yg,
+    double xr, double yr, double gamma, double iterations, double cutoff, int exact, int nthreads,
+    double *zg, double *wg, double *zd)
 {
   start = time(NULL);
-  int nx = x.size();
-  int nxg = xg.size();
-  int nyg = yg.size();
-  NumericMatrix zg(nxg, nyg), wg(nxg, nyg); // predictions on the grid
-  NumericVector zd(nx); // predictions at the data
-
-  //Rprintf("xg[0]=%f; size=%d\n", xg[0], xg.size());
-  //Rprintf("yg[0]=%f; size=%d\n", yg[0], yg.size());
-
-  double rgamma = gamma[0]; // gamma
-  if (rgamma < 0.0)
-    ::Rf_error("gamma=%f cannot be non-positive", rgamma);
-  int niter = floor(0.5 + iterations[0]); // number of iterations
+  if (gamma < 0.0)
+    ::Rf_error("gamma=%f cannot be non-positive", gamma);
+  int niter = floor(0.5 + iterations); // number of iterations
   if (niter < 0)
     ::Rf_error("cannot have a negative number of iterations.  Got %d ", niter);
   if (niter > 20)
     ::Rf_error("cannot have more than 20 iterations.  Got %d ", niter);
-  if (xr[0] <= 0)
-    ::Rf_error("cannot have xr<=0 but it is %f", xr[0]);
-  if (yr[0] <= 0)
-    ::Rf_error("cannot have yr<=0 but it is %f", yr[0]);
-  double xr2 = xr[0]; // local radius, which will vary with iteration
-  double yr2 = yr[0]; // local radius, which will vary with iteration
+  if (xr <= 0)
+    ::Rf_error("cannot have xr<=0 but it is %f", xr);
+  if (yr <= 0)
+    ::Rf_error("cannot have yr<=0 but it is %f", yr);
+  if (ISNAN(cutoff) || cutoff <= 0.0)
+    ::Rf_error("cutoff must be positive, but it is %f", cutoff);
+  double xr2 = xr; // local radius, which will vary with iteration
+  double yr2 = yr; // local radius, which will vary with iteration
+  int indexed = R_FINITE(cutoff) && nx > 0;
+  if (nthreads < 1)
+    nthreads = 1;
+  barnes_index idx;
+  R_xlen_t ng = (R_xlen_t)nxg * nyg;
 
-  /* previous values and working matrix */
-  NumericVector z_last(nx); // .c had nx+100000 (??!!??)
-  NumericMatrix zz(nxg, nyg);
+  // Grid values start at 0, and so do the last estimates at the data.
+  // The z-z_last values are stored datum by datum, so that all fields
+  // for a datum are together.
+  std::fill(zg, zg + ng * nfield, 0.0);
+  std::fill(zd, zd + (R_xlen_t)nx * nfield, 0.0);
+  std::vector<double> z_last((size_t)nx * nfield, 0.0), dz((size_t)nx * nfield);
 
-  // initialize (Q: needed? I can't find docs on initialization)
-  std::fill(zz.begin(), zz.end(), 0.0);
-  std::fill(z_last.begin(), z_last.end(), 0.0);
-  std::fill(zd.begin(), zd.end(), 0.0);
-
-
-  for (int iter = 0; iter < niter; iter++) {
+  // Grid rows and data are handled in blocks, split among threads,
+  // with interrupts checked by the main thread between blocks. Every
+  // value is summed over the data in the same order by one thread, so
+  // results do not depend on the number of threads.
+  int rowBlock = 4 * nthreads;
+  int dataBlock = 1024 * nthreads;
+  for (int iter = 0; iter <= niter; iter++) {
+    // The final pass, iter=niter, finds just the weights on the grid.
+    int weightsOnly = iter == niter;
     //Rprintf("iter=%d xr2=%f yr2=%f\n", iter, xr2, yr2);
+    for (int k = 0; k < nx; k++)
+      for (int f = 0; f < nfield; f++)
+        dz[(size_t)k * nfield + f] = z[k + (R_xlen_t)nx * f] - z_last[(size_t)k * nfield + f];
+    if (indexed) {
+      // The radii change with iteration, so the index is rebuilt.
+      barnes_index_build(&idx, nx, nfield, x, y, w, xr2, yr2, cutoff);
+      for (int s = 0; s < nx; s++)
+        for (int f = 0; f < nfield; f++)
+          idx.dz[(size_t)s * nfield + f] = dz[(size_t)idx.order[s] * nfield + f];
+    }
     /* update grid */
-    for (int i = 0; i < nxg; i++) {
-      for (int j = 0; j < nyg; j++) {
-        zz(i, j) = interpolate_barnes(xg[i], yg[j], zz(i, j),
-            -1, /* no skip */
-            nx, &x[0], &y[0], &z[0], &w[0],
-            &z_last(0),
-            xr2, yr2, i==(nxg-1)&&j==(nyg-1));
+    for (int i0 = 0; i0 < nxg; i0 += rowBlock) {
+      int i1 = i0 + rowBlock < nxg ? i0 + rowBlock : nxg;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+      {
+        std::vector<double> sum(nfield), sum_w(nfield);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int i = i0; i < i1; i++) {
+          for (int j = 0; j < nyg; j++) {
+            if (indexed)
+              interpolate_barnes_indexed(xg[i], yg[j], &idx, nfield, xr2, yr2, !exact, &sum[0], &sum_w[0]);
+            else
+              interpolate_barnes(xg[i], yg[j],
+                  -1, /* no skip */
+                  nx, x, y, w,
+                  nfield, &dz[0],
+                  xr2, yr2, !exact, &sum[0], &sum_w[0]);
+            for (int f = 0; f < nfield; f++) {
+              R_xlen_t ij = i + (R_xlen_t)nxg * j + ng * f;
+              if (weightsOnly)
+                wg[ij] = (sum_w[f] > 0.0) ? sum_w[f] : NA_REAL;
+              else if (sum_w[f] > 0.0)
+                zg[ij] += sum[f] / sum_w[f];
+              else if (iter == 0)
+                zg[ij] = NA_REAL; // later passes keep the estimate, leaving blanking to 'trim'
+            }
+          }
+        }
       }
-      R_CheckUserInterrupt();
+      Rcpp::checkUserInterrupt(); // throws, unlike R_CheckUserInterrupt(), so vectors are freed
     }
+    if (weightsOnly)
+      break;
     /* interpolate grid back to data locations */
-    for (int k = 0; k < nx; k++) {
-      //Rprintf("  zd[%d] = %f (iter %d)\n", k, zd[k], iter);
-      zd[k] = interpolate_barnes(x[k], y[k], z_last[k],
-          -1, /* BUG: why not skip? */
-          nx, &x[0], &y[0], &z[0], &w[0],
-          &z_last(0),
-          xr2, yr2, 0);
-      //Rprintf("  -> zd[%d] = %f (iter %d)\n", k, zd[k], iter);
+    for (int k0 = 0; k0 < nx; k0 += dataBlock) {
+      int k1 = k0 + dataBlock < nx ? k0 + dataBlock : nx;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+      {
+        std::vector<double> sum(nfield), sum_w(nfield);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (int k = k0; k < k1; k++) {
+          if (indexed)
+            interpolate_barnes_indexed(x[k], y[k], &idx, nfield, xr2, yr2, !exact, &sum[0], &sum_w[0]);
+          else
+            interpolate_barnes(x[k], y[k],
+                -1, /* BUG: why not skip? */
+                nx, x, y, w,
+                nfield, &dz[0],
+                xr2, yr2, !exact, &sum[0], &sum_w[0]);
+          for (int f = 0; f < nfield; f++) {
+            R_xlen_t kf = k + (R_xlen_t)nx * f;
+            double last = z_last[(size_t)k * nfield + f];
+            if (ISNAN(z[kf]) || (sum_w[f] <= 0.0 && iter == 0))
+              zd[kf] = NA_REAL;
+            else
+              zd[kf] = sum_w[f] > 0.0 ? last + sum[f] / sum_w[f] : last;
+          }
+        }
+      }
+      Rcpp::checkUserInterrupt();
     }
-    R_CheckUserInterrupt();
     for (int k = 0; k < nx; k++)
-      z_last[k] = zd[k];
-    if (rgamma > 0.0) {
+      for (int f = 0; f < nfield; f++)
+        z_last[(size_t)k * nfield + f] = zd[k + (R_xlen_t)nx * f];
+    if (gamma > 0.0) {
       // refine search range for next iteration
-      xr2 *= sqrt(rgamma);
-      yr2 *= sqrt(rgamma);
+      xr2 *= sqrt(gamma);
+      yr2 *= sqrt(gamma);
     }
   }
+}
 
-  // copy matrix to return value
-  for (int i = 0; i < nxg; i++)
-    for (int j = 0; j < nyg; j++)
-      zg(i, j) = zz(i, j);
-
-  // weights at final region-of-influence radii
-  for (int i = 0; i < nxg; i++) {
-    for (int j = 0; j < nyg; j++) {
-      wg(i, j) = weight_barnes(xg[i], yg[j],
-          -1, /* no skip */
-          nx, &x[0], &y[0], &z[0], &w[0],
-          xr2, yr2);
-    }
-    R_CheckUserInterrupt();
-  }
+/*
+
+Barnes interpolation
+
+@description
+
+Interpolate (x,y,z) data to a grid, and back to the data locations,
+using the iterative Barnes scheme [1]. Without a cutoff, each grid
+node and datum is influenced by all the data, so the cost is
+proportional to iterations*(nxg*nyg+nx)*nx. With a finite cutoff, the
+data are sorted into buckets, and only those within 'cutoff' radii
+of a point are used. Each omitted datum has a weight below
+exp(-cutoff^2)*w, e.g. 1.4e-11*w for a cutoff of 5, which bounds the
+change in the sums of weights, but not the relative change, which can
+be large where data are sparse. Grid nodes with no data within the
+cutoff in the first iteration are NA; in later iterations, such nodes
+keep their previous values. The grid rows and the data are split
+among threads.
+
+@param x,y,z,w numeric vectors of data locations, values and weights.
+
+@param xg,yg numeric vectors defining the grid.
+
+@param xr,yr numeric values of the initial radii of influence.
+
+@param gamma numeric value by which the squares of the radii are
+multiplied at each iteration.
+
+@param iterations numeric value giving the number of iterations.
+
+@param cutoff numeric value giving the distance, in units of the radii,
+beyond which data are ignored, or Inf to use all the data.
+
+@param exact logical value indicating whether to compute weights with
+exp(). If FALSE, a vectorisable approximation is used instead, with a
+relative error under 1e-14.
+
+@param nthreads integer giving the number of threads to use, if the
+package was compiled with OpenMP support. The results do not depend on
+this value.
+
+@value a list holding "zg", the grid of values, "wg", the sum of
+weights at each grid node in the final iteration, and "zd", the
+values interpolated back to the data locations.
+
+@references
+
+1. S. E.  Koch and M.  DesJardins and P. J. Kocin, 1983.  ``An
+interactive Barnes objective map analysis scheme for use with
+satellite and conventional data,'' J.  Climate Appl.  Met., vol 22,
+p. 1487-1503.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_interp_barnes(NumericVector x, NumericVector y, NumericVector z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations, NumericVector cutoff, LogicalVector exact, IntegerVector nthreads)
+{
+  int nx = x.size();
+  int nxg = xg.size();
+  int nyg = yg.size();
+  NumericMatrix zg(nxg, nyg), wg(nxg, nyg); // predictions on the grid
+  NumericVector zd(nx); // predictions at the data
+  barnes(nx, &x[0], &y[0], &w[0], 1, &z[0], nxg, &xg[0], nyg, &yg[0],
+      xr[0], yr[0], gamma[0], iterations[0], cutoff[0], exact[0], nthreads[0],
+      &zg[0], &wg[0], &zd[0]);
+  return(List::create(Named("zg")=zg, Named("wg")=wg, Named("zd")=zd));
+}
+
+/*
+
+Barnes interpolation of several fields
+
+@description
+
+As do_interp_barnes(), but for several fields, measured at the same
+locations, given in the columns of a matrix. The Gaussian weights are
+computed once for each pair of grid node (or datum) and datum, and
+applied to all the fields, so the cost is little more than for one
+field. Missing values in a field are skipped in that field alone, so
+the results are as for separate calls on the non-missing data of each
+field.
+
+@param x,y,w numeric vectors of data locations and weights.
+
+@param z numeric matrix with one row per datum and one column per
+field. It may contain NA values.
+
+@param xg,yg,xr,yr,gamma,iterations,cutoff,exact,nthreads as for
+do_interp_barnes().
+
+@value a list holding "zg" and "wg", arrays of dimension
+c(length(xg),length(yg),ncol(z)) holding the gridded values and the
+sums of weights, and "zd", a matrix of the values interpolated back to
+the data locations, with the same dimension as z.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_interp_barnes_fields(NumericVector x, NumericVector y, NumericMatrix z, NumericVector w, NumericVector xg, NumericVector yg, NumericVector xr, NumericVector yr, NumericVector gamma, NumericVector iterations, NumericVector cutoff, LogicalVector exact, IntegerVector nthreads)
+{
+  int nx = x.size();
+  int nxg = xg.size();
+  int nyg = yg.size();
+  int nfield = z.ncol();
+  if (z.nrow() != nx)
+    ::Rf_error("z must have %d rows, one per datum, but it has %d", nx, z.nrow());
+  NumericVector zg((R_xlen_t)nxg * nyg * nfield), wg((R_xlen_t)nxg * nyg * nfield);
+  NumericMatrix zd(nx, nfield);
+  if (nfield > 0)
+    barnes(nx, &x[0], &y[0], &w[0], nfield, &z[0], nxg, &xg[0], nyg, &yg[0],
+        xr[0], yr[0], gamma[0], iterations[0], cutoff[0], exact[0], nthreads[0],
+        &zg[0], &wg[0], &zd[0]);
+  zg.attr("dim") = IntegerVector::create(nxg, nyg, nfield);
+  wg.attr("dim") = IntegerVector::create(nxg, nyg, nfield);
   return(List::create(Named("zg")=zg, Named("wg")=wg, Named("zd")=zd));
 }
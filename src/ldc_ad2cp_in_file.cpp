@@ -1,6 +1,9 @@
 /* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
 
 #include <Rcpp.h>
+#include <vector>
+#include <climits>
+#include "mapped_file.h"
 using namespace Rcpp;
 
 // Cross-reference work:
@@ -53,7 +56,18 @@ int ID_ALLOWED[NID_ALLOWED]={21, 22, 23, 24, 26, 27, 28, 29, 30, 31, 160};
    a value of 1 means to retrieve all the profiles, while a value of 2
    means to get every second profile.
 
-   @value a list containing 'index', 'length' and 'id'. The last of
+   @param nthreads integer giving the number of threads to use in
+   indexing the file. Values exceeding 1 only have an effect if the
+   file can be memory-mapped, if it is at least 8MB long, and if the
+   package was compiled with OpenMP support. The results do not
+   depend on this value. Only the parts of the file that are needed
+   to find 'to' records are indexed.
+
+   @param DEBUG integer, 1 or higher to turn on printing.
+
+   @value a list containing 'index', 'length' and 'id'. The first of
+   these holds byte offsets, as numeric values so that they are not
+   limited to 2^31, which matters for large files. The last of
    these mean: 0x16=21 for Burst Data Record; 0x16=22 for Average Data
    Record; 0x17=23 for Bottom Track Data Record; 0x18=24 for
    Interleaved Burst Data Record (beam 5); 0xA0=160 forString Data
@@ -123,28 +137,340 @@ Dan Kelley
 //
 // The code for this differs from that suggested by Nortek,
 // because we don't use a specific (msoft) compiler, so we
-// do not have access to misaligned_load16(). Also, I don't
-// think this will work properly if the number of bytes
-// is odd.
+// do not have access to misaligned_load16(). The bytes are
+// combined in little-endian order, so this works on any host
+// and at any alignment, which matters when 'data' points into a
+// memory-mapped file. If the number of bytes is odd, the last
+// byte is added with a zero high byte, rather than reading a
+// byte past the end of the record.
 //
-// FIXME: handle odd-numbered byte case.
-unsigned short cs(unsigned char *data, unsigned short size)
+// The 'size' argument is long enough to hold the 32-bit data
+// size used by 12-byte headers.
+unsigned short cs(const unsigned char *data, unsigned long size)
 {
   // It might be worth checking the matlab code at
   //     https://github.com/aodn/imos-toolbox/blob/master/Parser/readAD2CPBinary.m
   // for context, if problems ever arise.
   unsigned short checksum = 0xB58C;
-  for (int i = 0; i < size; i += 2) {
+  unsigned long i;
+  for (i = 0; i + 1 < size; i += 2) {
     checksum += (unsigned short)data[i] + 256*(unsigned short)data[i+1];
   }
+  if (i < size)
+    checksum += (unsigned short)data[i];
   return(checksum);
 }
 
+// A record located by ad2cp_step(). The 'start' is the offset of the
+// SYNC byte that begins the header, and 'bad' is 1 if the data
+// checksum did not match the value stated in the header.
+typedef struct {
+  size_t start;
+  unsigned int length;
+  unsigned char header_size;
+  unsigned char id;
+  unsigned char bad;
+} ad2cp_record;
+
+// Return values for ad2cp_step().
+#define AD2CP_OK 0      // found a record
+#define AD2CP_PARTIAL 1 // the record extends past the end of the file
+#define AD2CP_EOF 2     // got to end of file while resynchronizing
+#define AD2CP_ERROR 3   // malformed header; see 'error'
+
+// Decode the header at p[*cindex], and checksum the data that follow
+// it, in place. On success, *cindex is advanced to the next header;
+// after a checksum failure, that means stepping forward to a likely
+// header, i.e. a SYNC byte followed by a header size of 10 or 12, an
+// id byte, and the family of the present record. This follows the
+// logic (and the diagnostic messages) of the stdio-based loop in
+// do_ldc_ad2cp_in_file(), with the stepping in the resynchronization
+// mimicking the getc() calls of that loop, so that both methods give
+// identical results. Since the outcome depends on nothing but
+// *cindex, this may be called from several threads at once, provided
+// that 'verbose' is 0, which prevents printing.
+static int ad2cp_step(const unsigned char *p, size_t n, size_t *cindex, int verbose,
+    ad2cp_record *r, char *error, size_t lerror)
+{
+  size_t c = *cindex;
+#define FAIL(...) { snprintf(error, lerror, __VA_ARGS__); return(AD2CP_ERROR); }
+#define PERCENT (100.0*c/n)
+  size_t avail = c < n ? n - c : 0;
+  if (avail < 1)
+    FAIL("cannot read header.sync at cindex=%lu (%7.4f%% through file)\n",
+        (unsigned long)c, PERCENT);
+  const unsigned char *h = p + c;
+  if (h[0] != SYNC)
+    FAIL("expected header.sync to be 0x%02x but it was 0x%02x at cindex=%lu (%7.4f%% through file) ... skipping to next 0x%02x chacter...\n",
+        SYNC, h[0], (unsigned long)c, PERCENT, SYNC);
+  if (avail < 2)
+    FAIL("cannot read header_size at cindex=%lu\n", (unsigned long)c);
+  unsigned char header_size = h[1];
+  if (header_size < 2)
+    FAIL("impossible header.header_size %d at cindex=%lu (%7.4f%% through file)\n",
+        header_size, (unsigned long)c, PERCENT);
+  if (avail < 3)
+    FAIL("cannot read header.id at cindex=%lu (%7.4f%% through file)\n",
+        (unsigned long)c, PERCENT);
+  if (avail < 4)
+    FAIL("cannot read header.family at cindex=%lu (%7.4f%% through file)\n",
+        (unsigned long)c, PERCENT);
+  unsigned char family = h[3]; // used in recovery attempt, if a checksum error occurs
+  unsigned long data_size;
+  unsigned int o; // offset to data checksum
+  if (header_size == 10) {
+    if (avail < 6)
+      FAIL("cannot read bytes2 (for 16 bit header_size) at cindex=%lu (%7.4f%% through file)\n",
+          (unsigned long)c, PERCENT);
+    data_size = h[4] + 256 * h[5];
+    o = 6;
+  } else if (header_size == 12) {
+    if (avail < 8)
+      FAIL("cannot read bytes4 (for 32 bit header_size) at cindex=%lu (%7.4f%% through file)\n",
+          (unsigned long)c, PERCENT);
+    data_size = h[4] + 256 * (h[5] + 256 * (h[6] + 256 * (unsigned long)h[7]));
+    o = 8;
+  } else {
+    FAIL("header_size is %d, but it must be 10 or 12 at cindex=%lu (%7.4f%% through file)\n",
+        header_size, (unsigned long)c, PERCENT);
+  }
+  if (avail < o + 2)
+    FAIL("cannot read header.data_checksum at cindex=%lu (%7.4f%% through file)\n",
+        (unsigned long)c, PERCENT);
+  unsigned short data_checksum = h[o] + 256 * h[o+1];
+  if (avail < o + 4)
+    FAIL("cannot read header.header_checksum at cindex=%lu (%7.4f%% through file)\n",
+        (unsigned long)c, PERCENT);
+  c += header_size;
+  // Check that the whole record is in the file.
+  if (n - c < data_size) {
+    if (verbose)
+      Rprintf("warning: ldc_ad2cp_in_file() got to end of file after cindex=%lu (%7.4f%% through file); wanted %lu bytes but got only %lu\n",
+          (unsigned long)(c-header_size), PERCENT, data_size, (unsigned long)(n - c));
+    return(AD2CP_PARTIAL);
+  }
+  r->start = *cindex;
+  r->length = (unsigned int)data_size;
+  r->header_size = header_size;
+  r->id = h[2];
+  r->bad = 0;
+  c += data_size;
+  // Compare data checksum (computed in place) to the value stated in the header
+  unsigned short dbufcs = cs(p + c - data_size, data_size);
+  if (dbufcs != data_checksum) {
+    r->bad = 1;
+    if (verbose)
+      Rprintf("Data checksum error (expected 0x%02x but got 0x%02x) at index=%lu (%7.4f%% through file)\n",
+          data_checksum, dbufcs, (unsigned long)c, PERCENT);
+    while (1) {
+      if (++c > n) {
+        if (verbose)
+          Rprintf("... got to end of file while searching for a sync character (0x%02x)\n", SYNC);
+        return(AD2CP_EOF);
+      }
+      if (p[c-1] != SYNC)
+        continue;
+      if (++c > n) {
+        if (verbose)
+          Rprintf("    got to end of file while searching for a header-size character at cindex=%lu\n",
+              (unsigned long)c);
+        return(AD2CP_EOF);
+      }
+      int trial_header_size = p[c-1];
+      if (trial_header_size != 10 && trial_header_size != 12)
+        continue;
+      if (++c > n) {
+        if (verbose)
+          Rprintf("got to end of file while searching for a the 'id' byte\n");
+        return(AD2CP_EOF);
+      }
+      if (++c > n) {
+        if (verbose)
+          Rprintf("got to end of file while searching for a the 'family' byte\n");
+        return(AD2CP_EOF);
+      }
+      if (p[c-1] == family) {
+        c -= 4;
+        if (verbose)
+          Rprintf("   ... skipped forward to a possible header at index=%lu\n", (unsigned long)c);
+        break;
+      }
+    }
+  }
+  *cindex = c;
+  return(AD2CP_OK);
+#undef FAIL
+#undef PERCENT
+}
+
+// Find the first plausible header that starts in p[begin] to
+// p[end-1], i.e. a SYNC byte followed by a header size of 10 or 12,
+// an id byte, the AD2CP family byte, and a record whose data checksum
+// is correct. Returns n if there is none.
+static size_t ad2cp_find_header(const unsigned char *p, size_t n, size_t begin, size_t end)
+{
+  char error[512];
+  for (size_t i = begin; i < end; i++) {
+    const unsigned char *s = (const unsigned char *)memchr(p + i, SYNC, end - i);
+    if (!s)
+      break;
+    i = s - p;
+    if (i + 4 > n || (p[i+1] != 10 && p[i+1] != 12) || p[i+3] != FAMILY)
+      continue;
+    size_t c = i;
+    ad2cp_record r;
+    if (AD2CP_OK == ad2cp_step(p, n, &c, 0, &r, error, sizeof(error)) && !r.bad)
+      return(i);
+  }
+  return(n);
+}
+
+// Results of scanning a memory-mapped file with ad2cp_scan_mapped().
+// If 'error' is not empty after the scan, the caller should report it
+// with Rf_error(), after unmapping the file.
+typedef struct {
+  std::vector<double> index;
+  std::vector<unsigned int> length;
+  std::vector<unsigned int> id;
+  int checksum_failures;
+  int early_EOF;
+  char error[512];
+} ad2cp_scan;
+
+// The records found by one thread, in the byte range [begin, end).
+typedef struct {
+  size_t begin;
+  size_t end;
+  std::vector<ad2cp_record> records;
+} ad2cp_range;
+
+// Size of the byte ranges that are indexed in parallel, and the number
+// of ranges per thread that are indexed together, in one "wave".
+#define AD2CP_RANGE_SIZE (4 * 1024 * 1024)
+#define AD2CP_RANGES_PER_THREAD 4
+
+// Scan the memory-mapped bytes p[0] to p[n-1], starting with the
+// header that begins at p[cindex], and stopping after 'to_value'
+// records.
+//
+// If nthreads exceeds 1, the bytes from p[cindex] on are split into
+// ranges of AD2CP_RANGE_SIZE bytes (the last one holding the
+// remainder) and, in parallel, each range is indexed by starting at its
+// first plausible header (see ad2cp_find_header()) and stepping through
+// records until passing the end of the range. The ranges are indexed
+// in waves of AD2CP_RANGES_PER_THREAD*nthreads ranges, with a wave
+// being indexed only when the sequential pass described next enters
+// its first range, so that a scan that stops after a few records does
+// not index the whole file.
+//
+// The sequential pass steps through the records from p[cindex]. At
+// each step, the records found by the thread that indexed the range
+// holding the present position are searched for one that starts at
+// exactly that position. If there is one, and its checksum is correct,
+// it is used as is; otherwise, ad2cp_step() is called, which prints
+// the messages for a bad checksum, and finds the records that a thread
+// missed, e.g. if it started at a false header. Since ad2cp_step()
+// depends only on the position in the file, the outcome is the same as
+// for a purely sequential scan, whatever the number of threads.
+static void ad2cp_scan_mapped(const unsigned char *p, size_t n, size_t cindex,
+    unsigned int to_value, int nthreads, int debug, ad2cp_scan *res)
+{
+  res->checksum_failures = 0;
+  res->early_EOF = 0;
+  res->error[0] = '\0';
+  size_t first = cindex;
+  size_t nranges = nthreads > 1 ? (n - first) / AD2CP_RANGE_SIZE : 0;
+  if (nranges < 2)
+    nranges = 0; // not worth using threads
+  size_t wave_size = AD2CP_RANGES_PER_THREAD * (size_t)(nthreads > 1 ? nthreads : 1);
+  std::vector<ad2cp_range> wave; // ranges wave_first, wave_first+1, ...
+  size_t wave_first = 0;
+  res->index.reserve(to_value < 100000 ? to_value : 100000);
+  res->length.reserve(to_value < 100000 ? to_value : 100000);
+  res->id.reserve(to_value < 100000 ? to_value : 100000);
+
+  unsigned int chunk = 0;
+  ad2cp_record r;
+  while (chunk < to_value) {
+    if (cindex >= n)
+      break; // the last record ended at the end of the file
+    // Find the range that holds cindex, indexing a new wave of ranges
+    // if it lies beyond the present one.
+    const ad2cp_record *join = NULL;
+    if (nranges) {
+      size_t k = (cindex - first) / AD2CP_RANGE_SIZE;
+      if (k >= nranges)
+        k = nranges - 1;
+      if (wave.empty() || k >= wave_first + wave.size()) {
+        wave_first = k;
+        wave.clear();
+        wave.resize(k + wave_size < nranges ? wave_size : nranges - k);
+        for (size_t w = 0; w < wave.size(); w++) {
+          wave[w].begin = first + (wave_first + w) * AD2CP_RANGE_SIZE;
+          wave[w].end = wave_first + w == nranges - 1 ? n : wave[w].begin + AD2CP_RANGE_SIZE;
+        }
+        if (debug)
+          Rprintf("  indexing byte ranges %d to %d of %d with %d threads\n",
+              (int)wave_first + 1, (int)(wave_first + wave.size()), (int)nranges, nthreads);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+        for (long w = 0; w < (long)wave.size(); w++) {
+          char error[512];
+          ad2cp_record rw;
+          size_t c = ad2cp_find_header(p, n, wave[w].begin, wave[w].end);
+          while (c < wave[w].end) {
+            if (AD2CP_OK != ad2cp_step(p, n, &c, 0, &rw, error, sizeof(error)))
+              break;
+            wave[w].records.push_back(rw);
+          }
+        }
+      }
+      const std::vector<ad2cp_record> &rec = wave[k - wave_first].records;
+      size_t lo = 0, hi = rec.size();
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rec[mid].start < cindex)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo < rec.size() && rec[lo].start == cindex)
+        join = &rec[lo];
+    }
+    if (res->checksum_failures > 100) {
+      snprintf(res->error, sizeof(res->error), "more than 100 checksum errors");
+      return;
+    }
+    if (join && !join->bad) {
+      r = *join;
+      cindex += r.header_size + r.length;
+    } else {
+      int status = ad2cp_step(p, n, &cindex, 1, &r, res->error, sizeof(res->error));
+      if (status == AD2CP_ERROR)
+        return;
+      if (status == AD2CP_EOF)
+        res->early_EOF = 1;
+      if (status != AD2CP_OK)
+        break; // give up on further processing
+      if (r.bad)
+        res->checksum_failures++;
+    }
+    if (debug > 1)
+      Rprintf("Chunk %d at cindex=%lu (%.4f%% through file) size=%d dataSize=%u id=0x%02x\n",
+          chunk, (unsigned long)r.start, 100.0*r.start/n, r.header_size, r.length, r.id);
+    res->index.push_back((double)(r.start + r.header_size));
+    res->length.push_back(r.length);
+    res->id.push_back(r.id);
+    chunk++;
+  }
+}
 
 // [[Rcpp::export]]
-List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerVector to, IntegerVector by, IntegerVector DEBUG)
+List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerVector to, IntegerVector by, IntegerVector nthreads, IntegerVector DEBUG)
 {
   int debug = DEBUG[0] < 0 ? 0 : DEBUG[0];
+  int nthreads_value = nthreads[0] < 1 ? 1 : nthreads[0];
   std::string fn = Rcpp::as<std::string>(filename(0));
   FILE *fp = fopen(fn.c_str(), "rb");
   if (!fp)
@@ -160,6 +486,41 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
     ::Rf_error("'by' must be positive but it is %d", by[0]);
   //unsigned int by_value = by[0];
 
+  // Scan a memory-mapped view of the file, if the OS permits. If not,
+  // fall back to the stdio method that follows.
+  mapped_file map;
+  if (mapped_file_open(fn.c_str(), &map)) {
+    fclose(fp);
+    if (debug)
+      Rprintf("do_ldc_ad2cp_in_file(filename='%s', from=%d, to=%d, by=%d, nthreads=%d) using memory-mapped file of %lu bytes\n",
+          fn.c_str(), from[0], to[0], by[0], nthreads_value, (unsigned long)map.size);
+    const unsigned char *first = (const unsigned char *)memchr(map.data, SYNC, map.size);
+    if (!first) {
+      mapped_file_close(&map);
+      ::Rf_error("this file does not contain a single 0x%02x byte", SYNC);
+    }
+    ad2cp_scan scan;
+    ad2cp_scan_mapped(map.data, map.size, first - map.data, to_value, nthreads_value, debug, &scan);
+    mapped_file_close(&map);
+    if (scan.error[0])
+      ::Rf_error("%s", scan.error);
+    unsigned int nscan = scan.index.size();
+    NumericVector index(nscan);
+    IntegerVector length(nscan), id(nscan);
+    for (unsigned int i = 0; i < nscan; i++) {
+      index[i] = scan.index[i];
+      length[i] = scan.length[i];
+      id[i] = scan.id[i];
+    }
+    if (debug)
+      Rprintf("} # do_ldc_ad2cp_in_file()\n");
+    return(List::create(Named("index")=index,
+          Named("length")=length,
+          Named("id")=id,
+          Named("checksumFailures")=scan.checksum_failures,
+          Named("earlyEOF")=scan.early_EOF));
+  }
+
   // Find file size, and return to start
   fseek(fp, 0L, SEEK_END);
   unsigned long int fileSize = ftell(fp);
@@ -169,6 +530,12 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
         fn.c_str(), from[0], to[0], by[0]);
     Rprintf("  fileSize=%d\n", fileSize);
   }
+  // The byte counter that follows is 32 bits long.
+  if (fileSize > UINT_MAX) {
+    fclose(fp);
+    ::Rf_error("cannot index '%s', which holds %.0f bytes, because it cannot be memory-mapped",
+        fn.c_str(), (double)fileSize);
+  }
   unsigned int chunk = 0;
   unsigned int cindex = 0, cindex_last_good = 0;
   int checksum_failures = 0;
@@ -228,9 +595,12 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
     }
     size_t bytes_read;
     // read/check sync byte
-    if (1 != fread(&header.sync, 1, 1, fp))
+    if (1 != fread(&header.sync, 1, 1, fp)) {
+      if (feof(fp))
+        break; // the last record ended at the end of the file
       ::Rf_error("cannot read header.sync at cindex=%d (%7.4f%% through file)\n",
           cindex, 100.0*cindex/fileSize);
+    }
     if (header.sync != SYNC)
       ::Rf_error("expected header.sync to be 0x%02x but it was 0x%02x at cindex=%d (%7.4f%% through file) ... skipping to next 0x%02x chacter...\n", SYNC, header.sync, cindex, 100.0*cindex/fileSize, SYNC);
     if (1 != fread(&header.header_size, 1, 1, fp))
@@ -396,7 +766,8 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
       chunk++;
     }
   }
-  IntegerVector index(chunk), length(chunk), id(chunk);
+  NumericVector index(chunk);
+  IntegerVector length(chunk), id(chunk);
   for (unsigned int i = 0; i < chunk; i++) {
     index[i] = index_buf[i];
     length[i] = length_buf[i];
@@ -405,6 +776,8 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
   R_Free(index_buf);
   R_Free(length_buf);
   R_Free(id_buf);
+  R_Free(dbuf);
+  fclose(fp);
   if (debug)
     Rprintf("} # do_ldc_ad2cp_in_file()\n");
   return(List::create(Named("index")=index,
@@ -414,3 +787,388 @@ List do_ldc_ad2cp_in_file(CharacterVector filename, IntegerVector from, IntegerV
         Named("earlyEOF")=early_EOF));
 }
 
+
+// Time of a data record, in seconds since 1970, from the fields that
+// all AD2CP data records share [1 sec 6.1.2]. The value is -1 for
+// string records, which lack a time, and for records with impossible
+// times.
+static double ad2cp_record_time(const unsigned char *p, const ad2cp_record *r)
+{
+  if (r->id == 0xa0 || r->length < 16)
+    return(-1.0);
+  const unsigned char *d = p + r->start + r->header_size;
+  int year = 1900 + d[8], month = d[9], day = d[10];
+  int hour = d[11], minute = d[12], second = d[13];
+  if (month > 11 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+    return(-1.0);
+  // Days since 1970-01-01, for the proleptic Gregorian calendar.
+  int y = year - (month < 2);
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int m = month + 1;
+  int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + day - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  double days = (double)era * 146097 + doe - 719468;
+  return(86400.0 * days + 3600.0 * hour + 60.0 * minute + second
+      + 1e-4 * (d[14] + 256 * d[15]));
+}
+
+// Find the first record with a time that starts at or after byte
+// 'at'. This is the linear resynchronization step of
+// ad2cp_locate_time(), which lands at arbitrary locations within a
+// file. On success, *start and *t are set to the location of the
+// record and its time, and 1 is returned; otherwise, 0 is returned.
+static int ad2cp_probe(const unsigned char *p, size_t n, size_t at, size_t *start, double *t)
+{
+  char error[512];
+  ad2cp_record r;
+  size_t c = ad2cp_find_header(p, n, at, n);
+  while (c < n) {
+    if (AD2CP_OK != ad2cp_step(p, n, &c, 0, &r, error, sizeof(error)))
+      return(0);
+    if (!r.bad && 0.0 <= (*t = ad2cp_record_time(p, &r))) {
+      *start = r.start;
+      return(1);
+    }
+  }
+  return(0);
+}
+
+// Find the location of the first record with a time at or after
+// 'target' (if 'after' is 0) or after 'target' (if 'after' is 1),
+// stepping from the record that starts at p[first]. The location
+// is narrowed by bisection, with ad2cp_probe() used to find a record
+// near each trial location, until the remaining interval is small
+// enough that stepping through records is faster than further
+// probes. Since stepping starts at a valid header, the records
+// stepped through are the ones that a scan from the start of the file
+// would find (see ad2cp_scan_mapped()). If the probes reveal that
+// times decrease within the file, stepping starts at 'first'. The
+// return value is n if there is no such record.
+static size_t ad2cp_locate_time(const unsigned char *p, size_t n, size_t first,
+    double target, int after, int debug)
+{
+#define PASS(t) (after ? (t) > target : (t) >= target)
+  size_t lo = first, hi = n, s;
+  double t, tlo;
+  int probes = 1;
+  if (ad2cp_probe(p, n, first, &s, &tlo) && !PASS(tlo)) {
+    lo = s;
+    while (hi - lo > 262144) {
+      size_t mid = lo + (hi - lo) / 2;
+      probes++;
+      if (!ad2cp_probe(p, n, mid, &s, &t) || PASS(t)) {
+        hi = mid;
+      } else if (t < tlo) {
+        if (debug)
+          Rprintf("  time decreases between bytes %lu and %lu, so stepping from byte %lu\n",
+              (unsigned long)lo, (unsigned long)s, (unsigned long)first);
+        lo = first;
+        break;
+      } else {
+        lo = s;
+        tlo = t;
+      }
+    }
+  }
+  if (debug)
+    Rprintf("  after %d probes, stepping from byte %lu to find time %.4f\n",
+        probes, (unsigned long)lo, target);
+  char error[512];
+  ad2cp_record r;
+  size_t c = lo;
+  while (c < n) {
+    if (AD2CP_OK != ad2cp_step(p, n, &c, 0, &r, error, sizeof(error)))
+      break;
+    if (!r.bad && 0.0 <= (t = ad2cp_record_time(p, &r)) && PASS(t))
+      return(r.start);
+  }
+  return(n);
+#undef PASS
+}
+
+// Records located within two byte ranges of a file, the first
+// holding the leading string records and the second holding the
+// records of interest, by ad2cp_locate_ranges().
+typedef struct {
+  std::vector<double> index;
+  std::vector<unsigned int> length, id;
+  int checksum_failures;
+  int early_EOF;
+  size_t ranges[4];
+  size_t next; // just past the last record located in the second range
+  char error[512];
+} ad2cp_ranges;
+
+// Locate the records in p[first] to p[head_end-1] and in p[start] to
+// p[end-1], stepping as in do_ldc_ad2cp_in_file(), with its messages
+// about checksum failures if 'verbose' is 1. A record that is only
+// partly within the second range, e.g. because it is still being
+// written, ends the scan without an error, and 'next' is then its
+// location.
+static void ad2cp_locate_ranges(const unsigned char *p, size_t first, size_t head_end,
+    size_t start, size_t end, int verbose, ad2cp_ranges *res)
+{
+  ad2cp_record r;
+  res->checksum_failures = 0;
+  res->early_EOF = 0;
+  res->error[0] = '\0';
+  res->ranges[0] = first;
+  res->ranges[1] = head_end;
+  res->ranges[2] = start;
+  res->ranges[3] = end;
+  res->next = start;
+  size_t begin[2] = {first, start}, limit[2] = {head_end, end};
+  for (int k = 0; k < 2 && !res->error[0]; k++) {
+    size_t c = begin[k];
+    while (c < limit[k]) {
+      if (res->checksum_failures > 100) {
+        snprintf(res->error, sizeof(res->error), "more than 100 checksum errors");
+        break;
+      }
+      if (limit[k] - c < 2 || limit[k] - c < p[c + 1])
+        break; // an incomplete header
+      int status = ad2cp_step(p, limit[k], &c, verbose, &r, res->error, sizeof(res->error));
+      if (status == AD2CP_EOF)
+        res->early_EOF = 1;
+      if (status != AD2CP_OK)
+        break;
+      if (r.bad)
+        res->checksum_failures++;
+      res->index.push_back((double)(r.start + r.header_size));
+      res->length.push_back(r.length);
+      res->id.push_back(r.id);
+      if (k == 1)
+        res->next = c;
+    }
+  }
+}
+
+// Find the end of the string records, which hold the instrument
+// configuration, at the start of the file, looking no further than
+// p[start].
+static size_t ad2cp_head_end(const unsigned char *p, size_t n, size_t first, size_t start)
+{
+  char error[512];
+  ad2cp_record r;
+  size_t head_end = first;
+  while (head_end < start) {
+    size_t c = head_end;
+    if (AD2CP_OK != ad2cp_step(p, n, &c, 0, &r, error, sizeof(error)) || r.bad || r.id != 0xa0)
+      break;
+    head_end = c;
+  }
+  return(head_end);
+}
+
+static List ad2cp_ranges_list(const ad2cp_ranges *res)
+{
+  size_t N = res->index.size();
+  NumericVector oindex(N);
+  IntegerVector olength(N), oid(N);
+  for (size_t i = 0; i < N; i++) {
+    oindex[i] = res->index[i];
+    olength[i] = res->length[i];
+    oid[i] = res->id[i];
+  }
+  NumericVector ranges(4);
+  for (int i = 0; i < 4; i++)
+    ranges[i] = res->ranges[i];
+  return(List::create(Named("index")=oindex,
+        Named("length")=olength,
+        Named("id")=oid,
+        Named("checksumFailures")=res->checksum_failures,
+        Named("earlyEOF")=res->early_EOF,
+        Named("ranges")=ranges,
+        Named("next")=(double)res->next));
+}
+
+/*
+
+Locate AD2CP records within a time window
+
+@description
+
+Find the records that lie within a time window, without scanning the
+whole file. The start and end of the window are found by bisection
+over byte locations, and then the records between them are located
+as by do_ldc_ad2cp_in_file(). Pulling an hour of data from a file
+that holds months of data thus takes a few dozen probes, rather than
+a pass over gigabytes. String records at the start of the file, which
+hold the instrument configuration, are also located, so that
+read.adp.ad2cp() can examine them.
+
+The bisection assumes that the times of records increase through the
+file, apart from small jitter between record types (e.g. burst and
+average records). The window starts with the first record having time
+at or after 'from', and ends just before the first record having time
+after 'to', so records in the interior of the window are retained
+regardless of their type or time.
+
+@param filename character string indicating the file name.
+
+@param from,to numeric values holding the times of the start and end
+of the window, in seconds since 1970.
+
+@param DEBUG integer, 1 or higher to turn on printing.
+
+@value a list containing 'index', 'length' and 'id', as for
+do_ldc_ad2cp_in_file(), along with
+'checksumFailures', 'earlyEOF', and 'ranges'. The last of these is a
+vector of four byte offsets (counting from 0) that define two
+intervals of the file: the leading string records lie in
+[ranges[1],ranges[2]), and the records in the window lie in
+[ranges[3],ranges[4]). The first interval is empty if the window
+includes the start of the file.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_ad2cp_time_window(CharacterVector filename, NumericVector from, NumericVector to, IntegerVector DEBUG)
+{
+  int debug = DEBUG[0] < 0 ? 0 : DEBUG[0];
+  std::string fn = Rcpp::as<std::string>(filename(0));
+  if (from[0] > to[0])
+    ::Rf_error("'from' must not exceed 'to'");
+  // Use a memory-mapped view of the file, if the OS permits. If not,
+  // read the whole file, which is slower, but gives the same result.
+  mapped_file map;
+  std::vector<unsigned char> contents;
+  const unsigned char *p;
+  size_t n;
+  int mapped = mapped_file_open(fn.c_str(), &map);
+  if (mapped) {
+    p = map.data;
+    n = map.size;
+  } else {
+    FILE *fp = fopen(fn.c_str(), "rb");
+    if (!fp)
+      ::Rf_error("cannot open file '%s'\n", fn.c_str());
+    unsigned char block[65536];
+    size_t got;
+    while (0 < (got = fread(block, 1, sizeof(block), fp)))
+      contents.insert(contents.end(), block, block + got);
+    fclose(fp);
+    p = contents.size() ? &contents[0] : NULL;
+    n = contents.size();
+  }
+  if (debug)
+    Rprintf("do_ldc_ad2cp_time_window(filename='%s', from=%.4f, to=%.4f) with %s file of %lu bytes {\n",
+        fn.c_str(), from[0], to[0], mapped ? "memory-mapped" : "stdio-read", (unsigned long)n);
+  const unsigned char *sync = n ? (const unsigned char *)memchr(p, SYNC, n) : NULL;
+  if (!sync) {
+    if (mapped)
+      mapped_file_close(&map);
+    ::Rf_error("this file does not contain a single 0x%02x byte", SYNC);
+  }
+  size_t first = sync - p;
+  size_t start = ad2cp_locate_time(p, n, first, from[0], 0, debug);
+  size_t end = start < n ? ad2cp_locate_time(p, n, start, to[0], 1, debug) : n;
+  size_t head_end = ad2cp_head_end(p, n, first, start);
+  if (start < n && head_end >= start) {
+    start = first; // the window includes the head
+    head_end = first;
+  }
+  ad2cp_ranges ranges;
+  ad2cp_locate_ranges(p, first, head_end, start, end, 1, &ranges);
+  if (mapped)
+    mapped_file_close(&map);
+  if (ranges.error[0])
+    ::Rf_error("%s", ranges.error);
+  if (debug)
+    Rprintf("  found %d records in bytes [%lu,%lu) and [%lu,%lu)\n} # do_ldc_ad2cp_time_window()\n",
+        (int)ranges.index.size(), (unsigned long)first, (unsigned long)head_end,
+        (unsigned long)start, (unsigned long)end);
+  return(ad2cp_ranges_list(&ranges));
+}
+
+/*
+
+Locate the AD2CP records added to a growing file
+
+@description
+
+Locate the records that start at or after byte 'start', which is
+normally the 'next' value returned by a previous call, along with the
+string records at the start of the file, which hold the instrument
+configuration. Thus, a file that is being written by an instrument can
+be followed by examining only the bytes added since the previous call.
+The scan stops quietly at a record that is incomplete, i.e. that is
+still being written, and 'next' then points to its start, so that it
+will be found on the next call.
+
+@param filename character string indicating the file name.
+
+@param start numeric value giving the byte offset (counting from 0) at
+which to start, or 0 to locate all the records in the file.
+
+@param DEBUG integer, 1 or higher to turn on printing.
+
+@value a list as for do_ldc_ad2cp_time_window(), with the records
+starting at 'start' occupying [ranges[3],ranges[4]) and with 'next'
+holding the byte offset just past the last of them.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_ad2cp_follow(CharacterVector filename, NumericVector start, IntegerVector DEBUG)
+{
+  int debug = DEBUG[0] < 0 ? 0 : DEBUG[0];
+  std::string fn = Rcpp::as<std::string>(filename(0));
+  if (start[0] < 0)
+    ::Rf_error("'start' must not be negative");
+  mapped_file map;
+  std::vector<unsigned char> contents;
+  const unsigned char *p;
+  size_t n;
+  int mapped = mapped_file_open(fn.c_str(), &map);
+  if (mapped) {
+    p = map.data;
+    n = map.size;
+  } else {
+    FILE *fp = fopen(fn.c_str(), "rb");
+    if (!fp)
+      ::Rf_error("cannot open file '%s'\n", fn.c_str());
+    unsigned char block[65536];
+    size_t got;
+    while (0 < (got = fread(block, 1, sizeof(block), fp)))
+      contents.insert(contents.end(), block, block + got);
+    fclose(fp);
+    p = contents.size() ? &contents[0] : NULL;
+    n = contents.size();
+  }
+  const unsigned char *sync = n ? (const unsigned char *)memchr(p, SYNC, n) : NULL;
+  if (!sync) {
+    if (mapped)
+      mapped_file_close(&map);
+    ::Rf_error("this file does not contain a single 0x%02x byte", SYNC);
+  }
+  size_t first = sync - p;
+  size_t from = (size_t)start[0];
+  if (from < first)
+    from = first;
+  if (from > n)
+    from = n;
+  size_t head_end = from > first ? ad2cp_head_end(p, n, first, from) : first;
+  if (debug)
+    Rprintf("do_ldc_ad2cp_follow(filename='%s', start=%.0f) with %s file of %lu bytes\n",
+        fn.c_str(), start[0], mapped ? "memory-mapped" : "stdio-read", (unsigned long)n);
+  ad2cp_ranges ranges;
+  ad2cp_locate_ranges(p, first, head_end, from, n, 0, &ranges);
+  if (mapped)
+    mapped_file_close(&map);
+  if (ranges.error[0])
+    ::Rf_error("%s", ranges.error);
+  if (debug)
+    Rprintf("  found %d records, with the next record to start at byte %lu\n",
+        (int)ranges.index.size(), (unsigned long)ranges.next);
+  return(ad2cp_ranges_list(&ranges));
+}
@@ -3,6 +3,9 @@
 #include <Rcpp.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
 using namespace Rcpp;
 
 // Cross-reference work:
@@ -99,6 +102,366 @@ double oce_timegm(struct tm *t)
 }
 
 
+// Seek to an absolute position, with 64-bit offsets, so that indexed
+// reads work for files exceeding 2GB.
+static int oce_fseek(FILE *fp, double where)
+{
+#ifdef _WIN32
+  return(_fseeki64(fp, (__int64)where, SEEK_SET));
+#else
+  return(fseeko(fp, (off_t)where, SEEK_SET));
+#endif
+}
+
+// Find the length of a file, in bytes, with 64-bit offsets.
+static double oce_fsize(FILE *fp)
+{
+#ifdef _WIN32
+  if (0 != _fseeki64(fp, 0, SEEK_END))
+    return(0.0);
+  return((double)_ftelli64(fp));
+#else
+  if (0 != fseeko(fp, 0, SEEK_END))
+    return(0.0);
+  return((double)ftello(fp));
+#endif
+}
+
+// Block-buffered input for ldc_rdi(). Reading a byte at a time with
+// fgetc() dominated the time needed to scan multi-gigabyte files, so
+// instead we read the file in blocks of RDI_BLOCK bytes, and work
+// within those blocks. The functions mimic fgetc(), fread(), ftell()
+// and fseek(), so the scanning logic is unchanged.
+#define RDI_BLOCK 1048576
+
+typedef struct {
+  FILE *fp;
+  unsigned char *buf;
+  size_t pos, len; // next byte is buf[pos]; buf holds len bytes
+  double offset; // location of buf[0] in the file
+} rdi_reader;
+
+static void rdi_reader_init(rdi_reader *r, FILE *fp)
+{
+  r->fp = fp;
+  r->buf = (unsigned char *)R_Calloc((size_t)RDI_BLOCK, unsigned char);
+  r->pos = 0;
+  r->len = 0;
+  r->offset = 0.0;
+}
+
+static void rdi_reader_free(rdi_reader *r)
+{
+  R_Free(r->buf);
+}
+
+// Read the next block, returning 0 at the end of the file.
+static int rdi_fill(rdi_reader *r)
+{
+  r->offset += r->len;
+  r->pos = 0;
+  r->len = fread(r->buf, 1, RDI_BLOCK, r->fp);
+  return(r->len > 0);
+}
+
+static inline int rdi_getc(rdi_reader *r)
+{
+  if (r->pos == r->len && !rdi_fill(r))
+    return(EOF);
+  return(r->buf[r->pos++]);
+}
+
+// Copy n bytes into dst, returning the number copied, which is less
+// than n only at the end of the file.
+static size_t rdi_read(rdi_reader *r, unsigned char *dst, size_t n)
+{
+  size_t done = 0;
+  while (done < n) {
+    if (r->pos == r->len && !rdi_fill(r))
+      break;
+    size_t k = r->len - r->pos;
+    if (k > n - done)
+      k = n - done;
+    memcpy(dst + done, r->buf + r->pos, k);
+    r->pos += k;
+    done += k;
+  }
+  return(done);
+}
+
+static inline double rdi_tell(rdi_reader *r)
+{
+  return(r->offset + r->pos);
+}
+
+// Move to a location in the file, avoiding a read if it is within the
+// present block (as is usual when realigning after a bad checksum).
+static int rdi_seek(rdi_reader *r, double where)
+{
+  if (where >= r->offset && where <= r->offset + r->len) {
+    r->pos = (size_t)(where - r->offset);
+    return(0);
+  }
+  r->offset = where;
+  r->pos = 0;
+  r->len = 0;
+  return(oce_fseek(r->fp, where));
+}
+
+// Search for a 0x7f 0x7f pair, reading at most 'budget' bytes, in the
+// way of a loop that calls fgetc() and compares each byte with the one
+// before, initially '*clast'. This returns 1 if a pair is found, in
+// which case the second byte of the pair has just been read.  The
+// number of bytes read (counting reads at the end of the file) is
+// stored in *consumed, and *c and *clast are updated as they would be
+// in such a loop. Most of the work is done by memchr(), which C
+// libraries implement with vector instructions.
+static int rdi_find_pair(rdi_reader *r, unsigned long int budget,
+    int *c, int *clast, unsigned long int *consumed)
+{
+  *consumed = 0;
+  while (budget > 0) {
+    if (r->pos == r->len && !rdi_fill(r)) {
+      *consumed += budget;
+      *c = *clast = EOF;
+      return(0);
+    }
+    const unsigned char *p = r->buf + r->pos;
+    size_t span = r->len - r->pos;
+    if (span > budget)
+      span = budget;
+    if (*clast == 0x7f && p[0] == 0x7f) {
+      r->pos++;
+      *consumed += 1;
+      *c = 0x7f;
+      return(1);
+    }
+    const unsigned char *q = p, *end = p + span;
+    while (NULL != (q = (const unsigned char *)memchr(q, 0x7f, end - q)) && q + 1 < end) {
+      if (q[1] == 0x7f) {
+        size_t k = q + 2 - p;
+        r->pos += k;
+        *consumed += k;
+        *c = 0x7f;
+        return(1);
+      }
+      q += 2; // since q[1] is not 0x7f
+    }
+    r->pos += span;
+    *consumed += span;
+    budget -= span;
+    *c = *clast = p[span - 1];
+  }
+  return(0);
+}
+
+// Sum bytes, for checksums. RDI ensembles hold at most 65535 bytes,
+// so the sum fits in 32 bits. The independent partial sums let
+// compilers use vector instructions for the additions.
+static unsigned int rdi_sum(const unsigned char *p, size_t n)
+{
+  unsigned int s[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    for (int j = 0; j < 8; j++)
+      s[j] += p[i + j];
+  for (; i < n; i++)
+    s[0] += p[i];
+  return(s[0] + s[1] + s[2] + s[3] + s[4] + s[5] + s[6] + s[7]);
+}
+
+// Ensemble selection, based on ensemble number (if mode is 0) or on
+// time (if mode is 1). This is used by do_ldc_rdi_in_file() as it
+// scans a file, and by do_ldc_rdi_from_index() as it steps through an
+// index created by do_ldc_rdi_index(), so that both select identical
+// ensembles. See the documentation of do_ldc_rdi_in_file() for the
+// meanings of 'from', 'to' and 'by'.
+typedef struct {
+  int mode;
+  unsigned long int from, to, by;
+  unsigned long int in_ensemble; // number of ensemble under examination (starts at 1)
+  unsigned long int counter, counter_last; // used for 'by', if mode is 0
+  time_t ensemble_time_last; // used for 'by', if mode is 1
+} rdi_selection;
+
+static void rdi_selection_init(rdi_selection *s, int mode,
+    unsigned long int from, unsigned long int to, unsigned long int by)
+{
+  s->mode = mode;
+  s->from = from;
+  s->to = to;
+  s->by = by;
+  s->in_ensemble = 1;
+  s->counter = 0;
+  s->counter_last = 0;
+  s->ensemble_time_last = 0;
+}
+
+// Decide whether to keep an ensemble that has passed the checksum
+// test, returning 1 if so. Also, set *done to 1 if no later ensemble
+// should be examined.
+static int rdi_select(rdi_selection *s, time_t ensemble_time, int *done)
+{
+  int keep = 0;
+  // Have we got to the starting location yet? Note the "-1"
+  // for the ensemble case, because R starts counts at 1, not 0,
+  // and the calling R code is (naturally) in R notation.
+  if ((s->mode == 0 && s->in_ensemble >= (s->from-1)) ||
+      (s->mode == 1 && ensemble_time >= (time_t)s->from)) {
+    // Handle the 'by' value.
+    if ((s->mode == 0 && (s->counter==s->from-1 || (s->counter - s->counter_last) >= s->by)) ||
+        (s->mode == 1 && (ensemble_time - s->ensemble_time_last) >= (time_t)s->by)) {
+      keep = 1;
+      // Increment counter (can be of two types)
+      if (s->mode == 1) {
+        s->ensemble_time_last = ensemble_time;
+      } else {
+        s->counter_last = s->counter;
+      }
+    }
+    s->counter++;
+  }
+  s->in_ensemble++;
+  // If 'to' is positive, check that we return only that many
+  // ensemble pointers.
+  *done = (s->mode == 0 && (s->to > 0 && s->in_ensemble > s->to)) ||
+    (s->mode == 1 && (ensemble_time >= (time_t)s->to));
+  return(keep);
+}
+
+// Decode the time of an ensemble, given a pointer to the byte that
+// follows the 0x7f 0x7f b1 b2 sequence at its start.
+static time_t rdi_ensemble_time(const unsigned char *ebuf, int *sec100)
+{
+  struct tm etime;
+  unsigned int time_pointer = (unsigned int)ebuf[4] + 256 * (unsigned int) ebuf[5];
+  etime.tm_year = 100 + (int) ebuf[time_pointer+0];
+  etime.tm_mon = -1 + (int) ebuf[time_pointer+1];
+  etime.tm_mday = (int) ebuf[time_pointer+2];
+  etime.tm_hour = (int) ebuf[time_pointer+3];
+  etime.tm_min = (int) ebuf[time_pointer+4];
+  etime.tm_sec = (int) ebuf[time_pointer+5];
+  etime.tm_isdst = 0;
+  *sec100 = ebuf[time_pointer+6];
+  // Use local timegm code, which I suppose is risky, but it
+  // does not seem that Microsoft Windows provides this function
+  // in a workable form.
+  return((time_t)oce_timegm(&etime));
+}
+
+// Size of the buffer used by rdi_probe(), enough to hold the largest
+// possible ensemble (its length is stored in 2 bytes).
+#define RDI_PROBE_BUF 65540
+
+// Find the first ensemble that starts at or after byte 'where'
+// (counting from 0) and before byte 'limit', that passes the checksum
+// test, and that has a variable leader with a plausible month. This
+// is the linear resynchronization step of rdi_locate_time(), which
+// lands at arbitrary locations within a file. On success, *found is
+// set to the location of the 0x7f 0x7f pair, *t is set to the time
+// of the ensemble, and 1 is returned. If no ensemble is found, 0 is
+// returned. The buffer 'ebuf' must hold RDI_PROBE_BUF bytes.
+static int rdi_probe(rdi_reader *r, double where, double limit,
+    unsigned char *ebuf, double *found, time_t *t)
+{
+  int c, clast = 0;
+  unsigned long int consumed;
+  if (0 != rdi_seek(r, where))
+    return(0);
+  double pos = where;
+  while (pos < limit) {
+    double span = limit - pos;
+    unsigned long int budget = span > 1e9 ? 1000000000UL : (unsigned long int)span;
+    int pair = rdi_find_pair(r, budget, &c, &clast, &consumed);
+    pos += consumed;
+    if (!pair) {
+      if (c == EOF)
+        return(0);
+      continue;
+    }
+    double start = pos - 2;
+    unsigned char b[2];
+    if (2 != rdi_read(r, b, 2))
+      return(0);
+    unsigned int bytes_to_check = (unsigned int)b[0] + 256 * (unsigned int)b[1];
+    if (bytes_to_check > 12) {
+      unsigned int n = bytes_to_check - 4; // as for 'bytes_to_read' in ldc_rdi()
+      if (n + 2 != rdi_read(r, ebuf, n + 2))
+        return(0);
+      unsigned short int check_sum = (unsigned short int)(0x7f + 0x7f + b[0] + b[1] + rdi_sum(ebuf, n));
+      unsigned short int desired_check_sum = (unsigned short int)(ebuf[n] | (ebuf[n+1] << 8));
+      unsigned int time_pointer = (unsigned int)ebuf[4] + 256 * (unsigned int)ebuf[5];
+      if (check_sum == desired_check_sum && time_pointer >= 4 && time_pointer + 7 <= n
+          && ebuf[time_pointer-4] == 0x80 && ebuf[time_pointer-3] == 0x00
+          && ebuf[time_pointer+1] >= 1 && ebuf[time_pointer+1] <= 12) {
+        int sec100;
+        *found = start;
+        *t = rdi_ensemble_time(ebuf, &sec100);
+        return(1);
+      }
+    }
+    // Not an ensemble, so look again, starting at the second byte of
+    // the 0x7f 0x7f pair.
+    if (0 != rdi_seek(r, start + 1))
+      return(0);
+    pos = start + 1;
+    clast = 0;
+  }
+  return(0);
+}
+
+// Find a good place to start scanning for ensembles with times at or
+// after 'target', by bisection over byte locations. At each step, a
+// probe lands at an arbitrary byte, and rdi_probe() steps forward to
+// the next valid ensemble. The return value is the location (counting
+// from 0) of an ensemble with time less than 'target', and as near as
+// possible to the first ensemble with time at or after 'target'; the
+// scan in ldc_rdi() then proceeds linearly from there. The bisection
+// stops when the bracketing interval is smaller than a block of the
+// reader, because the linear scan is faster than further probes. If
+// the first ensemble is already at or after 'target', or if the probes
+// reveal that times do not increase through the file (e.g. if an
+// instrument clock was reset), 'start' is returned, so that the whole
+// file is scanned, as before this scheme was introduced.
+static double rdi_locate_time(FILE *fp, double start, time_t target, int debug)
+{
+  double size = oce_fsize(fp);
+  oce_fseek(fp, 0.0); // the reader expects to start here
+  rdi_reader r;
+  rdi_reader_init(&r, fp);
+  unsigned char *ebuf = (unsigned char *)R_Calloc((size_t)RDI_PROBE_BUF, unsigned char);
+  double lo, hi = size;
+  time_t tlo;
+  int probes = 1;
+  if (rdi_probe(&r, start, size, ebuf, &lo, &tlo) && tlo < target) {
+    while (hi - lo > RDI_BLOCK) {
+      double mid = floor(lo + 0.5 * (hi - lo));
+      double e;
+      time_t te;
+      probes++;
+      if (!rdi_probe(&r, mid, hi, ebuf, &e, &te) || te >= target) {
+        hi = mid;
+      } else if (te < tlo) {
+        if (debug > 0)
+          Rprintf("rdi_locate_time(): time decreases between bytes %.0f and %.0f, so scanning whole file\n", lo, e);
+        lo = start;
+        break;
+      } else {
+        lo = e;
+        tlo = te;
+      }
+    }
+  } else {
+    lo = start;
+  }
+  R_Free(ebuf);
+  rdi_reader_free(&r);
+  oce_fseek(fp, 0.0);
+  if (debug > 0)
+    Rprintf("rdi_locate_time(): after %d probes, starting scan at byte %.0f of %.0f\n", probes, lo, size);
+  return(lo);
+}
+
 
 /*
 
@@ -146,7 +509,9 @@ means to get every second profile.
 @param startIndex integer giving the location of the first 7f7f byte pair.
 
 @param mode integer, 0 if 'from' etc are profile numbers or 1 if they
-are the numerical values of unix times.
+are the numerical values of unix times. In the latter case, the scan
+does not start at 'startIndex', but rather near the ensemble with
+time 'from', found by bisection (see do_ldc_rdi_seek_time()).
 
 @param debug integer, 1 or higher to turn on printing. Note that the R function
 subtracts 1 from the debug level, before calling this C++ fucction. In other
@@ -183,16 +548,28 @@ Dan Kelley
 
 */
 
-// [[Rcpp::export]]
-List do_ldc_rdi_in_file(StringVector filename,
+// Tasks for ldc_rdi().
+#define LDC_RDI_READ 0 // for do_ldc_rdi_in_file()
+#define LDC_RDI_INDEX 1 // for do_ldc_rdi_index(): locate, but do not copy
+#define LDC_RDI_BATCH 2 // for do_ldc_rdi_batch(): resume at a given byte
+#define LDC_RDI_FOLLOW 3 // for do_ldc_rdi_follow(): locate, resuming at a given byte
+
+// Scan an RDI file, starting at byte start_index (in R notation). If
+// the scan resumes after a previous one, check_last is the length of
+// the last good ensemble that it found; otherwise, it is 0.
+static List ldc_rdi(StringVector filename,
     IntegerVector from, IntegerVector to, IntegerVector by,
-    IntegerVector startIndex,
+    double start_index,
     IntegerVector mode,
-    IntegerVector debug)
+    IntegerVector debug,
+    int task,
+    unsigned int check_last)
 {
-  struct tm etime; // time of the ensemble under examination
-  time_t ensemble_time = 0; // integer-ish form of the above (only calculated if mode=1)
-  time_t ensemble_time_last = 0; // we use this for 'by', if mode is 1
+  int index_only = task == LDC_RDI_INDEX || task == LDC_RDI_FOLLOW;
+  // A file that is being written will usually end partway through an
+  // ensemble, so do not report that when following one.
+  int quiet = task == LDC_RDI_FOLLOW;
+  time_t ensemble_time = 0; // time of the ensemble under examination
   std::string fn = Rcpp::as<std::string>(filename(0));
 
   FILE *fp = fopen(fn.c_str(), "rb");
@@ -207,7 +584,6 @@ List do_ldc_rdi_in_file(StringVector filename,
   if (by[0] < 0)
     ::Rf_error("'by' must be positive");
   unsigned long int by_value = by[0];
-  unsigned long int start_index = startIndex[0];
   int mode_value = mode[0];
   if (mode_value != 0 && mode_value != 1)
     ::Rf_error("'mode' must be 0 or 1");
@@ -215,27 +591,56 @@ List do_ldc_rdi_in_file(StringVector filename,
   if (debug_value < 0)
     debug_value = 0;
   if (debug_value > 0)
-    Rprintf("In C++ function named do_ldc_rdi_in_file: diagnostics will be printed because debug>0\n");
+    Rprintf("In C++ function named %s: diagnostics will be printed because debug>0\n",
+        task == LDC_RDI_INDEX ? "do_ldc_rdi_index" :
+        (task == LDC_RDI_BATCH ? "do_ldc_rdi_batch" :
+         (task == LDC_RDI_FOLLOW ? "do_ldc_rdi_follow" : "do_ldc_rdi_in_file")));
   //Rprintf("from=%d, to=%d, by=%d, mode_value=%d\n", from_value, to_value, by_value, mode_value);
   int c, clast=0x00;
   int byte1 = 0x7f;
   int byte2 = 0x7f;
   unsigned short int check_sum, desired_check_sum;
   unsigned int bytes_to_check = 0;
-  unsigned int bytes_to_check_last = 0; // used to prevent freakouts if the chunk length is wrong (issue 1437)
-  unsigned long int cindex = 0;
+  unsigned int bytes_to_check_last = check_last; // used to prevent freakouts if the chunk length is wrong (issue 1437)
+  double cindex = 0; // number of bytes read (a double, for files over 4GB)
   unsigned long outEnsemblePointer = 1;
+  int eof = 0; // set to 1 if the scan ends at the end of the file
+  double resume_index = start_index; // just past the last good ensemble, in R notation
+  // For a time-based read, skip ahead to the neighbourhood of the
+  // requested start time.
+  int located = 0;
+  if (task == LDC_RDI_READ && mode_value == 1) {
+    double first = start_index > 1 ? start_index - 1 : 0.0;
+    double at = rdi_locate_time(fp, first, (time_t)from_value, debug_value);
+    if (at > first) {
+      start_index = at + 1;
+      located = 1;
+    }
+  }
   if (start_index > 1) {
-    Rprintf("In C++ function named ldc_rdi_in_file: skipping %d bytes at the start of the file, to get to 7F7F byte pair\n", start_index-1);
-    for (unsigned int i=1; i < start_index; i++) {
-      fgetc(fp);
-      cindex++;
+    // Skip to the first ensemble, or (for a batch) resume at the start
+    // of an ensemble found by a previous call.
+    if (task != LDC_RDI_BATCH && task != LDC_RDI_FOLLOW && !located)
+      Rprintf("In C++ function named ldc_rdi_in_file: skipping %.0f bytes at the start of the file, to get to 7F7F byte pair\n", start_index-1);
+    if (0 != oce_fseek(fp, start_index - 1)) {
+      fclose(fp);
+      ::Rf_error("cannot seek to byte %.0f in file '%s'", start_index, fn.c_str());
     }
+    cindex = start_index - 1;
   }
-  clast = fgetc(fp);
+  rdi_reader r;
+  rdi_reader_init(&r, fp);
+  r.offset = cindex;
+  clast = rdi_getc(&r);
   cindex++;
-  if (clast == EOF)
-    ::Rf_error("empty file '%s'", fn.c_str());
+  if (clast == EOF) {
+    if (task != LDC_RDI_BATCH && task != LDC_RDI_FOLLOW) {
+      rdi_reader_free(&r);
+      fclose(fp);
+      ::Rf_error("empty file '%s'", fn.c_str());
+    }
+    eof = 1; // a previous batch (or scan) ended at the end of the file
+  }
   // 'obuf' is a growable C buffer to hold the output, which eventually
   // gets saved in the R item "buf".
   unsigned long int nobuf = 100000; // BUFFER SIZE
@@ -250,24 +655,29 @@ List do_ldc_rdi_in_file(StringVector filename,
   // Note that we do not check the Calloc() results because the R docs say that
   // Calloc() performs its won tests, and that R will handle any problems.
   unsigned long int nensembles = 100000; // BUFFER SIZE
-  unsigned int *ensemble_in_files = (unsigned int *)R_Calloc((size_t)nensembles, unsigned int);
+  double *ensemble_in_files = (double *)R_Calloc((size_t)nensembles, double);
   int *ensembles = (int *)R_Calloc((size_t)nensembles, int);
   int *times = (int *)R_Calloc((size_t)nensembles, int);
   int *sec100s = (int *)R_Calloc((size_t)nensembles, int);
+  int *lengths = (int *)R_Calloc((size_t)nensembles, int);
   unsigned long int nebuf = 50000; // BUFFER SIZE
   unsigned char *ebuf = (unsigned char *)R_Calloc((size_t)nebuf, unsigned char);
 
-  unsigned long int in_ensemble = 1, out_ensemble = 0;
+  unsigned long int out_ensemble = 0;
   int b1, b2;
 
-  unsigned long int counter = 0, counter_last = 0;
-  unsigned int long last7f7f = 0;
+  rdi_selection selection;
+  rdi_selection_init(&selection, mode_value, from_value, to_value, by_value);
+  double last7f7f = 0;
+  unsigned long int consumed;
 
-  while (1) {
-    c = fgetc(fp);
+  while (!eof) {
+    c = rdi_getc(&r);
     cindex++;
     if (c == EOF) {
-      Rprintf("Got to end of data while trying to read the first header byte of an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+      if (!quiet)
+        Rprintf("Got to end of data while trying to read the first header byte of an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+      eof = 1;
       break;
     }
     // Locate "ensemble starts", spots where a 0x7f is followed by a second 0x7f,
@@ -279,20 +689,24 @@ List do_ldc_rdi_in_file(StringVector filename,
       // ensemble, and the data in the ensemble (sans the two bytes
       // at the end of the data, which store the checksum).
       if (debug_value > 0)
-        Rprintf("0x7f 0x7f at position %d (cindex %d) last7f7f=%d\n", ftell(fp), cindex, last7f7f);
+        Rprintf("0x7f 0x7f at position %.0f (cindex %.0f) last7f7f=%.0f\n", rdi_tell(&r), cindex, last7f7f);
       check_sum = (unsigned short int)byte1;
       check_sum += (unsigned short int)byte2;
-      b1 = fgetc(fp);
+      b1 = rdi_getc(&r);
       cindex++;
       if (b1 == EOF) {
-        Rprintf("Got to end of data while trying to read the 'b1' byte of an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+        if (!quiet)
+          Rprintf("Got to end of data while trying to read the 'b1' byte of an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+        eof = 1;
         break;
       }
       check_sum += (unsigned short int)b1;
-      b2 = fgetc(fp);
+      b2 = rdi_getc(&r);
       cindex++;
       if (b2 == EOF) {
-        Rprintf("Got to end of data while trying to read the 'b2' byte of an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+        if (!quiet)
+          Rprintf("Got to end of data while trying to read the 'b2' byte of an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+        eof = 1;
         break;
       }
       check_sum += (unsigned short int)b2;
@@ -307,8 +721,11 @@ List do_ldc_rdi_in_file(StringVector filename,
         R_Free(ensembles);
         R_Free(times);
         R_Free(sec100s);
+        R_Free(lengths);
         R_Free(ebuf);
-        ::Rf_error("cannot decode the length of ensemble number %d", in_ensemble);
+        rdi_reader_free(&r);
+        fclose(fp);
+        ::Rf_error("cannot decode the length of ensemble number %d", selection.in_ensemble);
       }
       if (bytes_to_check < 4)
         ::Rf_error("bytes_to_check should be >=4 but it is %d\n", bytes_to_check);
@@ -321,36 +738,39 @@ List do_ldc_rdi_in_file(StringVector filename,
         ebuf = (unsigned char *)R_Realloc(ebuf, bytes_to_read, unsigned char);
         nebuf = bytes_to_read;
       }
-      // Read the bytes in one operation, because fgetc() is too slow.
-      unsigned int bytesRead;
-      bytesRead = fread(ebuf, bytes_to_read, sizeof(unsigned char), fp);
-      if (feof(fp) || bytesRead == 0) {
-        Rprintf("Got to end of data while trying to read an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+      // Read the bytes in one operation, because byte-by-byte reading is too slow.
+      if (bytes_to_read != rdi_read(&r, ebuf, bytes_to_read)) {
+        if (!quiet)
+          Rprintf("Got to end of data while trying to read an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+        eof = 1;
         break;
       }
       cindex += bytes_to_read;
-      for (unsigned int ib = 0; ib < bytes_to_read; ib++) {
-        check_sum += (unsigned short int)ebuf[ib];
-      }
+      check_sum += (unsigned short int)rdi_sum(ebuf, bytes_to_read);
       int cs1, cs2;
-      cs1 = fgetc(fp);
+      cs1 = rdi_getc(&r);
       cindex++;
       if (cs1 == EOF) {
-        Rprintf("Got to end of data while trying to get the first checksum byte in an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+        if (!quiet)
+          Rprintf("Got to end of data while trying to get the first checksum byte in an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+        eof = 1;
         break;
       }
-      cs2 = fgetc(fp);
+      cs2 = rdi_getc(&r);
       cindex++;
       if (cs2 == EOF) {
-        Rprintf("Got to end of data while trying to get second checksum byte in an RDI file (cindex=%d; last7f7f=%d)\n", cindex, last7f7f);
+        if (!quiet)
+          Rprintf("Got to end of data while trying to get second checksum byte in an RDI file (cindex=%.0f; last7f7f=%.0f)\n", cindex, last7f7f);
+        eof = 1;
         break;
       }
       desired_check_sum = ((unsigned short int)cs1) | ((unsigned short int)(cs2 << 8));
       if (check_sum == desired_check_sum) {
         if (debug_value > 0)
-          Rprintf("good checksum at cindex=%d (check_sum=%d desired_check_sum=%d bytes_to_read=%d last7f7f=%d)\n",
+          Rprintf("good checksum at cindex=%.0f (check_sum=%d desired_check_sum=%d bytes_to_read=%d last7f7f=%.0f)\n",
               cindex, check_sum, desired_check_sum, bytes_to_read, last7f7f);
         bytes_to_check_last = bytes_to_check; // use later, if find bad checksum (issue 1437)
+        resume_index = cindex + 1;
         // The check_sum is ok, so we may want to store the results for
         // this profile.
         //
@@ -364,58 +784,30 @@ List do_ldc_rdi_in_file(StringVector filename,
           nensembles = 3 * nensembles / 2;
           if (debug_value > -1)
             Rprintf("Increasing ensembles,times,sec100s storage to %d elements ...\n", nensembles);
-          ensemble_in_files = (unsigned int *) R_Realloc(ensemble_in_files, nensembles, unsigned int);
+          ensemble_in_files = (double *) R_Realloc(ensemble_in_files, nensembles, double);
           ensembles = (int *) R_Realloc(ensembles, nensembles, int);
           times = (int *) R_Realloc(times, nensembles, int);
           sec100s = (int *)R_Realloc(sec100s, nensembles, int);
+          lengths = (int *)R_Realloc(lengths, nensembles, int);
         }
         // We will decide whether to keep this ensemble, based on ensemble
-        // number, if mode_value==0 or on time, if mode_value==1. That
-        // means we only need to compute a time if mode_value==1.
-        unsigned int time_pointer = (unsigned int)ebuf[4] + 256 * (unsigned int) ebuf[5];
-        etime.tm_year = 100 + (int) ebuf[time_pointer+0];
-        etime.tm_mon = -1 + (int) ebuf[time_pointer+1];
-        etime.tm_mday = (int) ebuf[time_pointer+2];
-        etime.tm_hour = (int) ebuf[time_pointer+3];
-        etime.tm_min = (int) ebuf[time_pointer+4];
-        etime.tm_sec = (int) ebuf[time_pointer+5];
-        etime.tm_isdst = 0;
-        // Use local timegm code, which I suppose is risky, but it
-        // does not seem that Microsoft Windows provides this function
-        // in a workable form.
-        ensemble_time = oce_timegm(&etime);
-        // See whether we are past the 'from' condition. Note the "-1"
-        // for the ensemble case, because R starts counts at 1, not 0,
-        // and the calling R code is (naturally) in R notation.
+        // number, if mode_value==0 or on time, if mode_value==1.
+        int sec100;
+        ensemble_time = rdi_ensemble_time(ebuf, &sec100);
         if (debug_value > 0 && out_ensemble<OUTLIM)
-          Rprintf("  in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", in_ensemble, from_value, counter,  counter_last);
-        // Have we got to the starting location yet?
-        if ((mode_value == 0 && in_ensemble >= (from_value-1)) ||
-            (mode_value == 1 && ensemble_time >= (time_t)from_value)) {
-          //if (out_ensemble<OUTLIM) Rprintf("  STAGE 2 in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", in_ensemble, from_value, counter,  counter_last);
-          // Handle the 'by' value.
-          if ((mode_value == 0 && (counter==from_value-1 || (counter - counter_last) >= by_value)) ||
-              (mode_value == 1 && (ensemble_time - ensemble_time_last) >= (time_t)by_value)) {
-            //if (out_ensemble<OUTLIM) Rprintf("  STAGE 3 in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", in_ensemble, from_value, counter,  counter_last);
-            // Copy ensemble to output buffer, after 6 bytes of header
-            // FIXME: next is wrong. should have a cumsum
-            ensemble_in_files[out_ensemble] = 1 + last7f7f; // use R index-from-1 notation
-            ensembles[out_ensemble] = outEnsemblePointer;
-            outEnsemblePointer = outEnsemblePointer + 6 + bytes_to_read; // 6 bytes for: 0x7f,0x7f,b1,b2,cs1,cs2
-            times[out_ensemble] = ensemble_time;
-            // Increment counter (can be of two types)
-            if (mode_value == 1) {
-              ensemble_time_last = ensemble_time;
-            } else {
-              counter_last = counter;
-            }
-            //Rprintf("saving at in_ensemble=%d, counter=%d, by=%d\n", in_ensemble, counter, by_value);
-            //    ensembles[out_ensemble] = last_start;
-            unsigned int timePointer = (unsigned int)ebuf[4] + 256 * (unsigned int) ebuf[5];
-            sec100s[out_ensemble] = ebuf[timePointer+6];
-            out_ensemble++;
-            // Save to output buffer.
-            // {{{
+          Rprintf("  in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", selection.in_ensemble, from_value, selection.counter,  selection.counter_last);
+        int done;
+        if (rdi_select(&selection, ensemble_time, &done)) {
+          ensemble_in_files[out_ensemble] = 1 + last7f7f; // use R index-from-1 notation
+          ensembles[out_ensemble] = outEnsemblePointer;
+          outEnsemblePointer = outEnsemblePointer + 6 + bytes_to_read; // 6 bytes for: 0x7f,0x7f,b1,b2,cs1,cs2
+          times[out_ensemble] = ensemble_time;
+          sec100s[out_ensemble] = sec100;
+          lengths[out_ensemble] = 6 + bytes_to_read;
+          out_ensemble++;
+          // Save to output buffer, unless we are just indexing the file.
+          // {{{
+          if (!index_only) {
             if ((iobuf + 100 + bytes_to_read) >= nobuf) {
               nobuf = nobuf + 100 + bytes_to_read + nobuf / 2;
               if (debug_value > 0)
@@ -428,119 +820,103 @@ List do_ldc_rdi_in_file(StringVector filename,
             obuf[iobuf++] = byte2; // 0x7f
             obuf[iobuf++] = b1; // length of ensemble, byte 1
             obuf[iobuf++] = b2; // length of ensemble, byte 1
-            for (unsigned int i = 0; i < bytes_to_read; i++)
-              obuf[iobuf++] = ebuf[i]; // data, not including the checksum
+            memcpy(obuf + iobuf, ebuf, bytes_to_read); // data, not including the checksum
+            iobuf += bytes_to_read;
             obuf[iobuf++] = cs1; // checksum  byte 1
             obuf[iobuf++] = cs2; // checksum  byte 2
-            // }}}
-          } else {
-            if (debug_value > 0)
-              Rprintf("Skipping at in_ensemble=%d, counter=%d, by=%d\n", in_ensemble, counter, by_value);
           }
-          counter++;
+          // }}}
+        } else {
+          if (debug_value > 0)
+            Rprintf("Skipping at in_ensemble=%d, counter=%d, by=%d\n", selection.in_ensemble, selection.counter, by_value);
         }
-        in_ensemble++;
-        // If 'max' is positive, check that we return only that many
-        // ensemble pointers.
-        //> Rprintf("L417 in_ensemble=%d from_value=%d to_value=%d\n", in_ensemble, from_value, to_value);
-        if ((mode_value == 0 && (to_value > 0 && in_ensemble > to_value)) ||
-            (mode_value == 1 && (ensemble_time >= (time_t)to_value))) {
+        if (done)
           break;
-        }
       } else {
-        cindex = ftell(fp); // synch up, just to be sure (cost is low since this rarely happens)
-        Rprintf("Warning: bad checksum at byte %d in file (check_sum=%d desired_check_sum=%d bytes_to_read=%d bytes_to_read_last=%d)\n", cindex, check_sum, desired_check_sum, bytes_to_read, bytes_to_check_last);
+        cindex = rdi_tell(&r); // synch up, just to be sure (cost is low since this rarely happens)
+        Rprintf("Warning: bad checksum at byte %.0f in file (check_sum=%d desired_check_sum=%d bytes_to_read=%d bytes_to_read_last=%d)\n", cindex, check_sum, desired_check_sum, bytes_to_read, bytes_to_check_last);
         // maybe the number of bytes to check was wrong (issue 1437)
         if (bytes_to_check_last != bytes_to_check) {
-          if (bytes_to_check == 0)
+          if (bytes_to_check_last == 0) {
+            rdi_reader_free(&r);
+            fclose(fp);
             ::Rf_error("cannot read this file, because the first ensemble has a checksum error\n");
+          }
           if (debug_value > 0)
             Rprintf("the problem may be that length (%d bytes) disagrees with previous (%d bytes)\n", bytes_to_check, bytes_to_check_last);
           // Skip to just past the last 7f7f, and then start looking
           // for the next valid 7f7f.
           cindex = last7f7f;
-          fseek(fp, last7f7f, SEEK_SET);
+          rdi_seek(&r, last7f7f);
           clast = 0;
-          for (unsigned int iii = 0; iii < 2 * bytes_to_check_last; iii++) {
-            c = fgetc(fp);
-            cindex++;
+          unsigned long int budget = 2 * (unsigned long int)bytes_to_check_last;
+          while (budget > 0) {
+            int found = rdi_find_pair(&r, budget, &c, &clast, &consumed);
+            cindex += consumed;
+            budget -= consumed;
+            if (!found)
+              break;
             if (debug_value > 0)
-              Rprintf("realign iii=%d cindex=%d c=0x%02x clast=0x%02x\n", iii, cindex, c, clast);
-            if (clast==byte1 && c == byte2) {
+              Rprintf(" got 7f 7f again at byte %.0f, after realigning. FYI bytes_to_check_last=%d\n", rdi_tell(&r), bytes_to_check_last);
+            // check if next two bytes give the expected length as
+            // before
+            b1 = rdi_getc(&r);
+            cindex++;
+            b2 = rdi_getc(&r);
+            cindex++;
+            bytes_to_check = (unsigned int)b1 + 256 * (unsigned int)b2;
+            if (bytes_to_check == bytes_to_check_last) {
+              rdi_seek(&r, rdi_tell(&r) - 2);
+              cindex = rdi_tell(&r); // synch up, just to be sure (cost is low since this rarely happens)
+              Rprintf("    ... recovered from bad checksum by restarting at byte %.0f in file\n", cindex);
+              break;
+            } else {
               if (debug_value > 0)
-                Rprintf(" got 7f 7f again at byte %d, after realigning. FYI bytes_to_check_last=%d\n", ftell(fp), bytes_to_check_last);
-              // check if next two bytes give the expected length as
-              // before
-              b1 = fgetc(fp);
-              cindex++;
-              b2 = fgetc(fp);
-              cindex++;
-              bytes_to_check = (unsigned int)b1 + 256 * (unsigned int)b2;
-              if (bytes_to_check == bytes_to_check_last) {
-                fseek(fp, -2L, SEEK_CUR);
-                cindex = ftell(fp); // synch up, just to be sure (cost is low since this rarely happens)
-                Rprintf("    ... recovered from bad checksum by restarting at byte %d in file\n", cindex);
-                break;
-              } else {
-                if (debug_value > 0)
-                  Rprintf(" ACCIDENTALLY MATCH since bytes_to_check=%d, not expected %d\n",bytes_to_check,bytes_to_check_last);
-              }
+                Rprintf(" ACCIDENTALLY MATCH since bytes_to_check=%d, not expected %d\n",bytes_to_check,bytes_to_check_last);
             }
             clast = c;
           }
-          //Rprintf(" moving file pointer to %d\n", last7f7f + bytes_to_check_last + 1);
-          //Rprintf("  BEFORE, ftell() says at %d\n", ftell(fp));
-          //fseek(fp, last7f7f + bytes_to_check_last + 1, SEEK_SET); // FIXME: may need to add 2 or 4 bytes, or subtract
-          //cindex = last7f7f + bytes_to_check_last + 1;
-          //clast = 0; // FIXME: is this right?
-          //Rprintf("  AFTER, ftell() says at %d\n", ftell(fp));
-          //c = 0; // FIXME: is this right?
         }
 
         if (debug_value > 0 && out_ensemble < OUTLIM)
-          Rprintf("  in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", in_ensemble, from_value, counter,  counter_last);
+          Rprintf("  in_ensemble=%d; from_value=%d; counter=%d; counter_last=%d\n", selection.in_ensemble, from_value, selection.counter,  selection.counter_last);
       }
       R_CheckUserInterrupt(); // only check once per ensemble, for speed
-      //fseek(fp,-1L,SEEK_CUR);Rprintf("OK  test at %d c=0x%02x\n", ftell(fp), fgetc(fp));
       clast = c;
     } else {
-      // Either clast != byte1 or c != byte2) {
-      //Rprintf("skipping byte. c=0x%02x clast=0x%02x  cindex=%d (ftell() says at pointer %d)\n", c, clast, cindex, ftell(fp));
-      //fseek(fp,-1L,SEEK_CUR);Rprintf("BAD test at %d c=0x%02x\n", ftell(fp), fgetc(fp));
-      cindex = ftell(fp); // synch up, just to be sure (cost is low since this rarely happens)
-      Rprintf("Warning: bad ensemble-start byte-pair at byte %d in file\n", cindex);
+      // Either clast != byte1 or c != byte2.
+      cindex = rdi_tell(&r); // synch up, just to be sure (cost is low since this rarely happens)
+      Rprintf("Warning: bad ensemble-start byte-pair at byte %.0f in file\n", cindex);
       if (debug_value > 0)
         Rprintf("try skipping to get 0x7f 0x7f pair\n");
-      for (unsigned int iii = 0; iii < 2 * bytes_to_check_last; iii++) {
-        c = fgetc(fp);
-        cindex++;
+      if (rdi_find_pair(&r, 2 * (unsigned long int)bytes_to_check_last, &c, &clast, &consumed)) {
+        cindex += consumed;
         if (debug_value > 0)
-          Rprintf("skipping iii=%d cindex=%d c=0x%02x clast=0x%02x\n", iii, cindex, c, clast);
-        if (clast==byte1 && c == byte2) {
-          if (debug_value > 0)
-            Rprintf(" got 7f 7f again at byte %d, after skipping. FYI bytes_to_check_last=%d\n", ftell(fp), bytes_to_check_last);
-          Rprintf("    ... recovered from bad ensemble-start byte-pair by restarting at byte %d in file\n", cindex);
-          // adjust file pointer
-          fseek(fp, -2L, SEEK_CUR);
-          cindex = ftell(fp); // synch again, for code clarity (cost is low since this rarely happens)
-          break;
-        }
-        clast = c;
+          Rprintf(" got 7f 7f again at byte %.0f, after skipping. FYI bytes_to_check_last=%d\n", rdi_tell(&r), bytes_to_check_last);
+        Rprintf("    ... recovered from bad ensemble-start byte-pair by restarting at byte %.0f in file\n", cindex);
+        // adjust file pointer
+        rdi_seek(&r, rdi_tell(&r) - 2);
+        cindex = rdi_tell(&r); // synch again, for code clarity (cost is low since this rarely happens)
+      } else {
+        cindex += consumed;
       }
       if (debug_value > 0)
       Rprintf("====\n");
     }
-    c = fgetc(fp);
+    c = rdi_getc(&r);
     cindex++;
     clast = c;
-    if (c == EOF)
+    if (c == EOF) {
+      eof = 1;
       break;
+    }
   }
+  rdi_reader_free(&r);
   fclose(fp);
 
   // Finally, copy into some R memory. Possibly we should have been
   // using this all along, but I wasn't clear on how to reallocate it.
-  IntegerVector ensemble_in_file(out_ensemble);
+  NumericVector ensemble_in_file(out_ensemble);
   IntegerVector ensemble(out_ensemble);
   IntegerVector sec100(out_ensemble);
   IntegerVector time(out_ensemble);
@@ -562,6 +938,28 @@ List do_ldc_rdi_in_file(StringVector filename,
     buf[i] = obuf[i];
   }
   R_Free(obuf);
+  if (index_only) {
+    IntegerVector length(out_ensemble);
+    for (unsigned long int i = 0; i < out_ensemble; i++)
+      length[i] = lengths[i];
+    R_Free(lengths);
+    if (debug_value > 0)
+      Rprintf("Returning from C++ function named do_ldc_rdi_index.\n");
+    return(List::create(Named("ensemble_in_file")=ensemble_in_file,
+          Named("length")=length, Named("time")=time, Named("sec100")=sec100,
+          Named("startIndex")=start_index, Named("nextIndex")=resume_index,
+          Named("checkLast")=(int)bytes_to_check_last));
+  }
+  R_Free(lengths);
+  if (task == LDC_RDI_BATCH) {
+    if (debug_value > 0)
+      Rprintf("Returning from C++ function named do_ldc_rdi_batch.\n");
+    return(List::create(Named("ensembleStart")=ensemble, Named("time")=time,
+          Named("sec100")=sec100, Named("buf")=buf,
+          Named("ensemble_in_file")=ensemble_in_file,
+          Named("nextIndex")=(double)cindex + 1.0, Named("eof")=eof,
+          Named("checkLast")=(int)bytes_to_check_last));
+  }
   if (debug_value > 0)
     Rprintf("Returning from C++ function named do_ldc_rdi_in_file.\n");
   return(List::create(Named("ensembleStart")=ensemble, Named("time")=time,
@@ -569,3 +967,266 @@ List do_ldc_rdi_in_file(StringVector filename,
         Named("ensemble_in_file")=ensemble_in_file));
 }
 
+// [[Rcpp::export]]
+List do_ldc_rdi_in_file(StringVector filename,
+    IntegerVector from, IntegerVector to, IntegerVector by,
+    IntegerVector startIndex,
+    IntegerVector mode,
+    IntegerVector debug)
+{
+  return(ldc_rdi(filename, from, to, by, startIndex[0], mode, debug, LDC_RDI_READ, 0));
+}
+
+/*
+
+Read a batch of RDI ensembles
+
+@description
+
+Read up to 'n' ensembles, starting at byte 'startIndex', which must
+be the first byte of an ensemble (or of the file). The return value
+includes the byte at which the next batch starts, so that a file can
+be processed a batch at a time, with memory use that is set by the
+batch size, not the file size. See rdiApply() in R/adp.rdi.R.
+
+@param filename character string naming an RDI adp file.
+
+@param startIndex numeric value giving the starting byte, in R
+notation. This is a numeric value, not an integer, so that it can
+exceed 2^31-1.
+
+@param n integer giving the maximum number of ensembles to read.
+
+@param checkLast integer, 0 for the first batch, or the "checkLast"
+value returned for the previous batch. This is needed to recover
+from checksum errors that occur at the start of a batch.
+
+@param debug as for do_ldc_rdi_in_file().
+
+@value a list containing the items returned by
+do_ldc_rdi_in_file(), along with "nextIndex", the starting byte for
+the next batch, and "eof", which is 1 if the end of the file was
+reached, or 0 otherwise, and "checkLast".
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_rdi_batch(StringVector filename, NumericVector startIndex,
+    IntegerVector n, IntegerVector checkLast, IntegerVector debug)
+{
+  if (n[0] < 1)
+    ::Rf_error("'n' must be positive");
+  IntegerVector from(1, 1), by(1, 1), mode(1, 0);
+  return(ldc_rdi(filename, from, n, by, startIndex[0], mode, debug, LDC_RDI_BATCH,
+        checkLast[0] > 0 ? checkLast[0] : 0));
+}
+
+/*
+
+Index an RDI file
+
+@description
+
+Scan a whole RDI file, recording the location, length, time and
+sec100 of every ensemble that passes the checksum test.  The result
+can be saved (see indexFileWrite() in R/misc.R) and later handed to
+do_ldc_rdi_from_index(), which can then extract a subset of the file
+without scanning it again.
+
+@param filename,startIndex,debug as for do_ldc_rdi_in_file().
+
+@value a list containing "ensemble_in_file" (the R-notation byte
+index of the 0x7f 0x7f pair at the start of each ensemble), "length"
+(the number of bytes in each ensemble, including the two checksum
+bytes), "time", "sec100" and "startIndex".
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_rdi_index(StringVector filename, IntegerVector startIndex, IntegerVector debug)
+{
+  IntegerVector from(1, 1), to(1, 0), by(1, 1), mode(1, 0);
+  return(ldc_rdi(filename, from, to, by, startIndex[0], mode, debug, LDC_RDI_INDEX, 0));
+}
+
+/*
+
+Locate the ensembles added to a growing RDI file
+
+@description
+
+Index the ensembles of an RDI file, as do_ldc_rdi_index() does, but
+starting at byte 'startIndex', which is normally the 'nextIndex' value
+returned by a previous call. Thus, a file that is being written by an
+instrument (e.g. on a cabled mooring) can be followed by reading only
+the bytes added since the previous call. The scan stops quietly at an
+ensemble that is incomplete, i.e. that is still being written, and
+'nextIndex' then points to its start, so that it will be found on the
+next call.
+
+@param filename character string naming an RDI adp file.
+
+@param startIndex numeric value giving the byte at which to start, in
+R notation.
+
+@param checkLast integer giving the length of the last ensemble found
+by the previous call, which is used in recovering from checksum
+errors, or 0 for the first call.
+
+@param debug integer, 1 or higher to turn on printing.
+
+@value a list as for do_ldc_rdi_index(), with "nextIndex" (the byte
+just past the last good ensemble, in R notation) and "checkLast" (to
+be supplied to the next call).
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_rdi_follow(StringVector filename, NumericVector startIndex,
+    IntegerVector checkLast, IntegerVector debug)
+{
+  IntegerVector from(1, 1), to(1, 0), by(1, 1), mode(1, 0);
+  if (checkLast[0] < 0)
+    ::Rf_error("'checkLast' must not be negative");
+  return(ldc_rdi(filename, from, to, by, startIndex[0], mode, debug, LDC_RDI_FOLLOW,
+        (unsigned int)checkLast[0]));
+}
+
+/*
+
+Find where to start reading an RDI file, for a given time
+
+@description
+
+Find the location of an ensemble that is at or shortly before the
+first ensemble with the given time, by bisection over byte locations
+within the file.  At each step of the bisection, the probe lands at an
+arbitrary byte and then steps forward to the next 0x7f 0x7f pair that
+starts an ensemble with a correct checksum.  A one-hour window from a
+file holding months of data is thus found after examining a few dozen
+ensembles, instead of all of them.  This is done automatically by
+do_ldc_rdi_in_file() if its 'mode' is 1; the present function is
+provided for testing.
+
+@param filename character string naming an RDI adp file.
+
+@param time integer giving the desired time, as the numerical value
+of a unix time.
+
+@param startIndex integer giving the location of the first 7f7f byte
+pair, as for do_ldc_rdi_in_file().
+
+@param debug integer, 1 or higher to turn on printing.
+
+@value the location of an ensemble, in R notation. Its time is
+less than 'time', unless it is the first ensemble. If ensemble times
+are found to decrease within the file, 'startIndex' is returned.
+
+*/
+
+// [[Rcpp::export]]
+NumericVector do_ldc_rdi_seek_time(StringVector filename, IntegerVector time,
+    IntegerVector startIndex, IntegerVector debug)
+{
+  std::string fn = Rcpp::as<std::string>(filename(0));
+  FILE *fp = fopen(fn.c_str(), "rb");
+  if (!fp)
+    ::Rf_error("cannot open file '%s'\n", fn.c_str());
+  double first = startIndex[0] > 1 ? startIndex[0] - 1 : 0.0;
+  double at = rdi_locate_time(fp, first, (time_t)time[0], debug[0]);
+  fclose(fp);
+  return(NumericVector::create(at + 1));
+}
+
+/*
+
+Locate Data Chunk for RDI, using an index
+
+@description
+
+Do the work of do_ldc_rdi_in_file(), using an index created by
+do_ldc_rdi_index().  The ensembles are selected with the same rules
+as in do_ldc_rdi_in_file(), after which only the selected ensembles
+are read from the file, so the return value is identical to what
+do_ldc_rdi_in_file() would yield.
+
+@param filename,from,to,by,mode,debug as for do_ldc_rdi_in_file().
+
+@param ensemble_in_file,length,time,sec100 the elements of the same
+names in the return value of do_ldc_rdi_index().
+
+@value as for do_ldc_rdi_in_file().
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_rdi_from_index(StringVector filename,
+    NumericVector ensemble_in_file, IntegerVector length,
+    IntegerVector time, IntegerVector sec100,
+    IntegerVector from, IntegerVector to, IntegerVector by,
+    IntegerVector mode,
+    IntegerVector debug)
+{
+  std::string fn = Rcpp::as<std::string>(filename(0));
+  if (from[0] < 0)
+    ::Rf_error("'from' must be positive");
+  if (to[0] < 0)
+    ::Rf_error("'to' must be positive");
+  if (by[0] < 0)
+    ::Rf_error("'by' must be positive");
+  int mode_value = mode[0];
+  if (mode_value != 0 && mode_value != 1)
+    ::Rf_error("'mode' must be 0 or 1");
+  int debug_value = debug[0];
+  long int n = ensemble_in_file.size();
+  if (length.size() != n || time.size() != n || sec100.size() != n)
+    ::Rf_error("'ensemble_in_file', 'length', 'time' and 'sec100' must have equal lengths");
+  // First pass: select ensembles, and tally the size of the output buffer.
+  rdi_selection selection;
+  rdi_selection_init(&selection, mode_value, from[0], to[0], by[0]);
+  std::vector<long int> keep;
+  size_t nbuf = 0;
+  for (long int i = 0; i < n; i++) {
+    int done;
+    if (rdi_select(&selection, (time_t)time[i], &done)) {
+      keep.push_back(i);
+      nbuf += length[i];
+    }
+    if (done)
+      break;
+  }
+  if (debug_value > 0)
+    Rprintf("In C++ function named do_ldc_rdi_from_index: selected %d of %d ensembles (%.0f bytes)\n",
+        (int)keep.size(), (int)n, (double)nbuf);
+  // Second pass: read the selected ensembles.
+  FILE *fp = fopen(fn.c_str(), "rb");
+  if (!fp)
+    ::Rf_error("cannot open file '%s'\n", fn.c_str());
+  long int nout = keep.size();
+  NumericVector oensemble_in_file(nout);
+  IntegerVector oensemble(nout);
+  IntegerVector otime(nout);
+  IntegerVector osec100(nout);
+  RawVector buf(nbuf);
+  size_t ibuf = 0;
+  for (long int k = 0; k < nout; k++) {
+    long int i = keep[k];
+    oensemble_in_file[k] = ensemble_in_file[i];
+    oensemble[k] = 1 + ibuf;
+    otime[k] = time[i];
+    osec100[k] = sec100[i];
+    if (0 != oce_fseek(fp, ensemble_in_file[i] - 1.0)
+        || 1 != fread(&buf[ibuf], length[i], 1, fp)) {
+      fclose(fp);
+      ::Rf_error("cannot read ensemble at byte %.0f of file '%s'; perhaps the index is out of date\n",
+          ensemble_in_file[i], fn.c_str());
+    }
+    ibuf += length[i];
+    R_CheckUserInterrupt();
+  }
+  fclose(fp);
+  return(List::create(Named("ensembleStart")=oensemble, Named("time")=otime,
+        Named("sec100")=osec100, Named("buf")=buf,
+        Named("ensemble_in_file")=oensemble_in_file));
+}
+
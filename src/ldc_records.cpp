@@ -0,0 +1,152 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+#include <Rcpp.h>
+#include <string>
+#include <vector>
+#include "record_locator.h"
+using namespace Rcpp;
+
+//#define DEBUG 1
+
+// Get an integer field from a record descriptor, or a default value
+// if the field is not present.
+static int rule_int(List rule, const char *name, int def)
+{
+  if (!rule.containsElementNamed(name))
+    return def;
+  IntegerVector v = rule[name];
+  if (v.size() != 1 || v[0] == NA_INTEGER)
+    ::Rf_error("record descriptor field '%s' must be a single integer", name);
+  return v[0];
+}
+
+/*
+
+Locate Nortek and SonTek records of several types
+
+@description
+
+Find all the records of the types described by 'rules', in a single
+pass through 'buf'. This replaces separate scans for each type of
+record, e.g. velocity, system and IMU records in Nortek Vector files.
+At each candidate location (i.e. at each byte that starts a sync
+sequence), the rules are tried in order, and the first that matches
+is taken. The scan then moves past records that have checksums, or
+by just one byte for records that do not.
+
+@param buf raw vector holding the data.
+
+@param rules a named list of record descriptors, each of which is a
+list with the following elements.  'sync' (required) is a raw vector
+of 1 to 8 bytes that start the record.  'length' is the record length
+in bytes; if this is 0 or absent, then the length is taken from the
+2-byte little-endian integer at offset 'lengthOffset', multiplied by
+'lengthUnit' (default 1), and if both are given, records are only
+accepted if the two lengths agree.  'idOffset' and 'id' (a raw value)
+name a further byte that identifies the record.  'checksum' is
+"none" (the default), "nortek" (for a sum of 2-byte words) or
+"sontek" (for a sum of bytes), with the sum starting at 'seed'
+(default 0xb58c for "nortek" and 0xa596 for "sontek") and being
+compared with the last 2 bytes of the record.
+
+@param debug integer; set positive to print information.
+
+@value a list with one numeric vector for each element of 'rules',
+and with the same names, holding the locations of the starts of the
+records, counting from 1. The "checksumFailures" attribute is an
+integer vector holding the number of candidates (of each type) that
+failed the checksum test.
+
+@examples
+
+# Nortek Vector velocity data and system data
+do_ldc_records(buf, list(vvd=list(sync=as.raw(c(0xa5, 0x10)), length=24L, checksum="nortek"),
+                         vsd=list(sync=as.raw(c(0xa5, 0x11)), length=28L, checksum="nortek")), 0L)
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_ldc_records(RawVector buf, List rules, IntegerVector debug)
+{
+  int nrules = rules.size();
+  if (nrules < 1)
+    ::Rf_error("must give at least one record descriptor");
+  CharacterVector names = rules.names();
+  if (names.size() != nrules)
+    ::Rf_error("record descriptors must be named");
+  std::vector<std::string> label(nrules);
+  std::vector<record_rule> r(nrules);
+  for (int k = 0; k < nrules; k++) {
+    List rule = rules[k];
+    label[k] = as<std::string>(names[k]);
+    record_rule_init(&r[k]);
+    if (!rule.containsElementNamed("sync"))
+      ::Rf_error("record descriptor '%s' lacks 'sync'", label[k].c_str());
+    RawVector sync = rule["sync"];
+    if (sync.size() < 1 || sync.size() > RECORD_SYNC_MAX)
+      ::Rf_error("'sync' in record descriptor '%s' must hold 1 to %d bytes", label[k].c_str(), RECORD_SYNC_MAX);
+    for (int j = 0; j < sync.size(); j++)
+      r[k].sync[j] = sync[j];
+    r[k].nsync = sync.size();
+    r[k].length = rule_int(rule, "length", 0);
+    r[k].length_offset = rule_int(rule, "lengthOffset", -1);
+    r[k].length_unit = rule_int(rule, "lengthUnit", 1);
+    if (r[k].length <= 0 && r[k].length_offset < 0)
+      ::Rf_error("record descriptor '%s' must have a positive 'length', or a 'lengthOffset'", label[k].c_str());
+    r[k].id_offset = rule_int(rule, "idOffset", -1);
+    if (r[k].id_offset >= 0) {
+      if (!rule.containsElementNamed("id"))
+        ::Rf_error("record descriptor '%s' has 'idOffset' but lacks 'id'", label[k].c_str());
+      RawVector id = rule["id"];
+      if (id.size() != 1)
+        ::Rf_error("'id' in record descriptor '%s' must be a single byte", label[k].c_str());
+      r[k].id = id[0];
+    }
+    std::string checksum = "none";
+    if (rule.containsElementNamed("checksum"))
+      checksum = as<std::string>(rule["checksum"]);
+    if (checksum == "nortek") {
+      r[k].checksum = RECORD_CHECKSUM_NORTEK;
+      r[k].seed = (unsigned short)rule_int(rule, "seed", 0xb58c);
+    } else if (checksum == "sontek") {
+      r[k].checksum = RECORD_CHECKSUM_SONTEK;
+      r[k].seed = (unsigned short)rule_int(rule, "seed", 0xa596);
+    } else if (checksum != "none") {
+      ::Rf_error("'checksum' in record descriptor '%s' must be \"none\", \"nortek\" or \"sontek\", not \"%s\"",
+          label[k].c_str(), checksum.c_str());
+    }
+#ifdef DEBUG
+    Rprintf("rule %d: nsync=%d length=%d length_offset=%d id_offset=%d checksum=%d seed=0x%04x\n",
+        k, r[k].nsync, r[k].length, r[k].length_offset, r[k].id_offset, r[k].checksum, r[k].seed);
+#endif
+  }
+  std::vector<int> bad(nrules);
+  record_scanner scanner;
+  record_scanner_init(&scanner, &r[0], nrules, &bad[0]);
+  std::vector< std::vector<double> > found(nrules);
+  const unsigned char *p = &buf[0];
+  ptrdiff_t n = buf.size();
+  ptrdiff_t i = 0;
+  int type, len;
+  while ((i = record_next(&scanner, p, n, i, &type, &len)) >= 0) {
+    found[type].push_back((double)(i + 1)); // the 1 is to offset from C to R
+    i += record_advance(&r[type], len);
+  }
+  List res(nrules);
+  IntegerVector failures(nrules);
+  for (int k = 0; k < nrules; k++) {
+    res[k] = NumericVector(found[k].begin(), found[k].end());
+    failures[k] = bad[k];
+    if (debug[0] > 0)
+      Rprintf("do_ldc_records() found %d '%s' records (%d checksum failures)\n",
+          (int)found[k].size(), label[k].c_str(), bad[k]);
+  }
+  res.names() = names;
+  failures.names() = names;
+  res.attr("checksumFailures") = failures;
+  return(res);
+}
@@ -0,0 +1,114 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+// Read-only memory mapping of a whole file, for the binary readers
+// (e.g. ldc_ad2cp_in_file.cpp) that must scan files that can be tens
+// of gigabytes in size. Mapping lets those scanners walk the bytes in
+// place, instead of copying each record into a buffer with fread().
+//
+// Usage:
+//   mapped_file m;
+//   if (mapped_file_open(fn.c_str(), &m)) {
+//     ... use m.data[0] through m.data[m.size-1] ...
+//     mapped_file_close(&m);
+//   } else {
+//     ... fall back to stdio ...
+//   }
+//
+// The open function returns 0 on failure (including the case of an
+// empty file, which cannot be mapped), so callers must always have an
+// stdio fallback.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int fd;
+#endif
+} mapped_file;
+
+static inline int mapped_file_open(const char *filename, mapped_file *m)
+{
+  m->data = NULL;
+  m->size = 0;
+#ifdef _WIN32
+  m->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (m->file == INVALID_HANDLE_VALUE)
+    return 0;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m->file, &size) || size.QuadPart == 0) {
+    CloseHandle(m->file);
+    return 0;
+  }
+  m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m->mapping == NULL) {
+    CloseHandle(m->file);
+    return 0;
+  }
+  m->data = (const unsigned char *)MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (m->data == NULL) {
+    CloseHandle(m->mapping);
+    CloseHandle(m->file);
+    return 0;
+  }
+  m->size = (size_t)size.QuadPart;
+#else
+  m->fd = open(filename, O_RDONLY);
+  if (m->fd < 0)
+    return 0;
+  struct stat st;
+  if (fstat(m->fd, &st) != 0 || st.st_size <= 0) {
+    close(m->fd);
+    return 0;
+  }
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+  if (p == MAP_FAILED) {
+    close(m->fd);
+    return 0;
+  }
+  // The scanners move forward through the file, so tell the kernel to
+  // read ahead aggressively. This is only a hint, so ignore failure.
+  madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+  m->data = (const unsigned char *)p;
+  m->size = (size_t)st.st_size;
+#endif
+  return 1;
+}
+
+static inline void mapped_file_close(mapped_file *m)
+{
+  if (m->data == NULL)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile((LPCVOID)m->data);
+  CloseHandle(m->mapping);
+  CloseHandle(m->file);
+#else
+  munmap((void *)m->data, m->size);
+  close(m->fd);
+#endif
+  m->data = NULL;
+  m->size = 0;
+}
+
+#endif
@@ -0,0 +1,296 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+#include <Rcpp.h>
+#include <vector>
+using namespace Rcpp;
+
+// Cross-reference work:
+// 1. update ../src/registerDynamicSymbol.c with an item for this
+// 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
+
+// Data-type IDs [1 table 33], as little-endian 16-bit values, so that
+// e.g. the bytes 0x00 0x01 that start a velocity chunk give 0x0100.
+#define RDI_FIXED_LEADER 0x0000
+#define RDI_VARIABLE_LEADER 0x0080
+#define RDI_VELOCITY 0x0100
+#define RDI_CORRELATION 0x0200
+#define RDI_ECHO_INTENSITY 0x0300
+#define RDI_PERCENT_GOOD 0x0400
+#define RDI_STATUS 0x0500
+#define RDI_BOTTOM_TRACK 0x0600
+#define RDI_VBEAM_VELOCITY 0x0a00
+#define RDI_VBEAM_CORRELATION 0x0b00
+#define RDI_VBEAM_AMPLITUDE 0x0c00
+#define RDI_VBEAM_PERCENT_GOOD 0x0d00
+
+static inline unsigned int rdi_uint16(const unsigned char *p)
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static inline int rdi_int16(const unsigned char *p)
+{
+  return (short)rdi_uint16(p);
+}
+
+/*
+
+Decode RDI ensembles
+
+@description
+
+Walk the data-type offset table of each ensemble, decoding the chunks
+that read.adp.rdi() formerly decoded with readBin() calls inside a
+loop over ensembles, and storing the results directly in arrays.
+Chunks with IDs that are not in 'ids' are not decoded; instead, the
+ensembles holding them are listed in the "other" item of the return
+value, so that the calling R code can handle them (e.g. VMDAS
+navigation and WinRiver NMEA chunks).
+
+@param buf raw vector holding the ensembles, as returned by
+do_ldc_rdi_in_file().
+
+@param ensembleStart integer or numeric vector holding the starting
+indices (in R notation) of the ensembles within buf.
+
+@param ncells,nbeams integers giving the number of cells and beams.
+
+@param nvcells integer giving the number of cells in the vertical
+beam of a 5-beam Sentinel V instrument, or 0 for other instruments.
+
+@param ids integer vector of the IDs of the chunks that are to be
+decoded, in little-endian form, e.g. 0x0100 for velocity, which is
+signalled by the bytes 0x00 0x01. The IDs of the fixed and variable
+leaders are 0x0000 and 0x0080. Setting an ID for velocity,
+correlation, echo intensity, percent good, bottom track or one of the
+vertical-beam items yields an item in the return value.
+
+@value a list holding "orientation" (1 for upward, 0 for downward, NA
+for ensembles lacking a fixed leader), "ensembleNumber", "other"
+(indices of ensembles holding other chunks), "n" (the number of
+ensembles decoded, which is less than length(ensembleStart) if buf
+ends within an ensemble), and arrays named as in read.adp.rdi(),
+namely "v", "q", "a" and "g" (dimensions length(ensembleStart),
+ncells and nbeams), "br", "bv", "bc", "ba" and "bg" (dimensions
+length(ensembleStart) and nbeams), and "vv", "vq", "va" and "vg"
+(dimensions length(ensembleStart) and nvcells). Velocities are in m/s,
+with NA for the bad-data value of -32768.
+
+@references
+
+1. Teledyne RD Instruments, 2014. Ocean Surveyor/Ocean Observer
+Technical Manual. P/N 95A-6012-00 April 2014 (OS_TM_Apr14.pdf)
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_rdi_columns(RawVector buf, NumericVector ensembleStart,
+    IntegerVector ncells, IntegerVector nbeams, IntegerVector nvcells,
+    IntegerVector ids)
+{
+  R_xlen_t nbuf = buf.size();
+  R_xlen_t N = ensembleStart.size();
+  int ncell = ncells[0];
+  int nbeam = nbeams[0];
+  int nvcell = nvcells[0];
+  if (ncell < 0 || nbeam < 0 || nvcell < 0)
+    ::Rf_error("ncells, nbeams and nvcells must be non-negative, but they are %d, %d and %d", ncell, nbeam, nvcell);
+  R_xlen_t items = (R_xlen_t)ncell * nbeam;
+  const unsigned char *b = (const unsigned char *)RAW(buf);
+  // IDs to decode, as a lookup table.
+  std::vector<unsigned char> want(65536, 0);
+  for (R_xlen_t k = 0; k < ids.size(); k++) {
+    if (ids[k] < 0 || ids[k] > 65535)
+      ::Rf_error("ids[%ld]=%d is not a 16-bit value", (long)(k+1), ids[k]);
+    want[ids[k]] = 1;
+  }
+#define WANT(id) (want[(id)] != 0)
+  IntegerVector orientation(N, NA_INTEGER);
+  NumericVector ensembleNumber(N, 0.0); // as in read.adp.rdi() before this function existed
+  NumericVector v, br, bv, bc, ba, bg, vv;
+  RawVector q, a, g, vq, va, vg;
+  if (WANT(RDI_VELOCITY)) {
+    v = NumericVector(N * items, NA_REAL);
+    v.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (WANT(RDI_CORRELATION)) {
+    q = RawVector(N * items);
+    q.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (WANT(RDI_ECHO_INTENSITY)) {
+    a = RawVector(N * items);
+    a.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (WANT(RDI_PERCENT_GOOD)) {
+    g = RawVector(N * items);
+    g.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  }
+  if (WANT(RDI_BOTTOM_TRACK)) {
+    br = NumericVector(N * nbeam, NA_REAL);
+    bv = NumericVector(N * nbeam, NA_REAL);
+    bc = NumericVector(N * nbeam, NA_REAL);
+    ba = NumericVector(N * nbeam, NA_REAL);
+    bg = NumericVector(N * nbeam, NA_REAL);
+    br.attr("dim") = IntegerVector::create(N, nbeam);
+    bv.attr("dim") = IntegerVector::create(N, nbeam);
+    bc.attr("dim") = IntegerVector::create(N, nbeam);
+    ba.attr("dim") = IntegerVector::create(N, nbeam);
+    bg.attr("dim") = IntegerVector::create(N, nbeam);
+  }
+  if (WANT(RDI_VBEAM_VELOCITY)) {
+    vv = NumericVector(N * nvcell, NA_REAL);
+    vv.attr("dim") = IntegerVector::create(N, nvcell);
+  }
+  if (WANT(RDI_VBEAM_CORRELATION)) {
+    vq = RawVector(N * nvcell);
+    vq.attr("dim") = IntegerVector::create(N, nvcell);
+  }
+  if (WANT(RDI_VBEAM_AMPLITUDE)) {
+    va = RawVector(N * nvcell);
+    va.attr("dim") = IntegerVector::create(N, nvcell);
+  }
+  if (WANT(RDI_VBEAM_PERCENT_GOOD)) {
+    vg = RawVector(N * nvcell);
+    vg.attr("dim") = IntegerVector::create(N, nvcell);
+  }
+  // Bottom-track data hold 4 beams [1 table 45].
+  int nbeam_bt = nbeam < 4 ? nbeam : 4;
+  std::vector<int> other;
+  R_xlen_t i;
+  for (i = 0; i < N; i++) {
+    R_xlen_t start = (R_xlen_t)ensembleStart[i] - 1; // R uses 1-based indices
+    if (start < 0 || start + 6 > nbuf)
+      break;
+    const unsigned char *e = b + start;
+    unsigned int ntypes = e[5];
+    if (start + 6 + 2 * (R_xlen_t)ntypes > nbuf)
+      break;
+    int truncated = 0, is_other = 0;
+    for (unsigned int chunk = 0; chunk < ntypes; chunk++) {
+      R_xlen_t o = start + rdi_int16(e + 6 + 2 * chunk);
+      if (o < 0 || o + 2 > nbuf) {
+        truncated = 1;
+        break;
+      }
+      const unsigned char *p = b + o;
+      unsigned int id = rdi_uint16(p);
+      if (!WANT(id)) {
+        is_other = 1;
+        continue;
+      }
+      // Find the chunk length, so we can check against overruns.
+      R_xlen_t need = 2;
+      switch (id) {
+      case RDI_FIXED_LEADER: need = 5; break;
+      case RDI_VARIABLE_LEADER: need = 12; break;
+      case RDI_VELOCITY: need = 2 + 2 * items; break;
+      case RDI_CORRELATION:
+      case RDI_ECHO_INTENSITY:
+      case RDI_PERCENT_GOOD: need = 2 + items; break;
+      case RDI_BOTTOM_TRACK: need = 81; break;
+      case RDI_VBEAM_VELOCITY: need = 2 + 2 * (R_xlen_t)nvcell; break;
+      case RDI_VBEAM_CORRELATION:
+      case RDI_VBEAM_AMPLITUDE:
+      case RDI_VBEAM_PERCENT_GOOD: need = 2 + nvcell; break;
+      }
+      if (o + need > nbuf) {
+        truncated = 1;
+        break;
+      }
+      switch (id) {
+      case RDI_FIXED_LEADER:
+        orientation[i] = (p[4] & 0x80) ? 1 : 0;
+        break;
+      case RDI_VARIABLE_LEADER:
+        // The factor 65535 (not 65536) is as in read.adp.rdi() before
+        // this function existed.
+        ensembleNumber[i] = rdi_int16(p + 2) + 65535.0 * p[11];
+        break;
+      case RDI_VELOCITY:
+        // Within a chunk, beams vary fastest, then cells; in the output
+        // arrays, ensembles vary fastest.
+        for (int k = 0; k < ncell; k++) {
+          for (int j = 0; j < nbeam; j++) {
+            int tmp = rdi_int16(p + 2 + 2 * ((R_xlen_t)k * nbeam + j));
+            v[i + N * (k + (R_xlen_t)ncell * j)] = tmp == -32768 ? NA_REAL : 1e-3 * tmp;
+          }
+        }
+        break;
+      case RDI_CORRELATION:
+      case RDI_ECHO_INTENSITY:
+      case RDI_PERCENT_GOOD:
+        {
+          RawVector &x = id == RDI_CORRELATION ? q : (id == RDI_ECHO_INTENSITY ? a : g);
+          for (int k = 0; k < ncell; k++)
+            for (int j = 0; j < nbeam; j++)
+              x[i + N * (k + (R_xlen_t)ncell * j)] = p[2 + (R_xlen_t)k * nbeam + j];
+        }
+        break;
+      case RDI_STATUS:
+        break; // ignored, as in read.adp.rdi()
+      case RDI_BOTTOM_TRACK:
+        for (int j = 0; j < nbeam_bt; j++) {
+          br[i + N * j] = 0.01 * (65536.0 * p[77 + j] + rdi_uint16(p + 16 + 2 * j));
+          bv[i + N * j] = 0.001 * rdi_int16(p + 24 + 2 * j);
+          bc[i + N * j] = p[32 + j];
+          ba[i + N * j] = p[36 + j];
+          bg[i + N * j] = p[40 + j];
+        }
+        break;
+      case RDI_VBEAM_VELOCITY:
+        for (int k = 0; k < nvcell; k++) {
+          int tmp = rdi_int16(p + 2 + 2 * k);
+          vv[i + N * k] = tmp == -32768 ? NA_REAL : 1e-3 * tmp;
+        }
+        break;
+      case RDI_VBEAM_CORRELATION:
+      case RDI_VBEAM_AMPLITUDE:
+      case RDI_VBEAM_PERCENT_GOOD:
+        {
+          RawVector &x = id == RDI_VBEAM_CORRELATION ? vq : (id == RDI_VBEAM_AMPLITUDE ? va : vg);
+          for (int k = 0; k < nvcell; k++)
+            x[i + N * k] = p[2 + k];
+        }
+        break;
+      default:
+        is_other = 1; // an ID in 'ids' that this function cannot decode
+        break;
+      }
+    }
+    if (truncated)
+      break;
+    if (is_other)
+      other.push_back((int)(i + 1));
+    if (i % 10000 == 0)
+      R_CheckUserInterrupt();
+  }
+  IntegerVector otherR(other.size());
+  for (size_t k = 0; k < other.size(); k++)
+    otherR[k] = other[k];
+  List res;
+  res["orientation"] = orientation;
+  res["ensembleNumber"] = ensembleNumber;
+  res["other"] = otherR;
+  res["n"] = (double)i;
+  if (WANT(RDI_VELOCITY)) res["v"] = v;
+  if (WANT(RDI_CORRELATION)) res["q"] = q;
+  if (WANT(RDI_ECHO_INTENSITY)) res["a"] = a;
+  if (WANT(RDI_PERCENT_GOOD)) res["g"] = g;
+  if (WANT(RDI_BOTTOM_TRACK)) {
+    res["br"] = br;
+    res["bv"] = bv;
+    res["bc"] = bc;
+    res["ba"] = ba;
+    res["bg"] = bg;
+  }
+  if (WANT(RDI_VBEAM_VELOCITY)) res["vv"] = vv;
+  if (WANT(RDI_VBEAM_CORRELATION)) res["vq"] = vq;
+  if (WANT(RDI_VBEAM_AMPLITUDE)) res["va"] = va;
+  if (WANT(RDI_VBEAM_PERCENT_GOOD)) res["vg"] = vg;
+#undef WANT
+  return(res);
+}
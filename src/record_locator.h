@@ -0,0 +1,175 @@
+/* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
+
+// Table-driven location of binary records, for Nortek and SonTek
+// files, in which each record starts with some sync bytes, has a
+// length that is either fixed or stored in the record, and (usually)
+// ends with a 2-byte checksum.
+//
+// Usage:
+//   record_rule rules[2];
+//   ... fill in rules, e.g. with record_rule_init() and then setting
+//       the fields that differ from the defaults ...
+//   record_scanner s;
+//   record_scanner_init(&s, rules, 2, NULL);
+//   ptrdiff_t i = 0;
+//   int type, len;
+//   while ((i = record_next(&s, buf, n, i, &type, &len)) >= 0) {
+//     ... a record of type 'type' and 'len' bytes starts at buf[i] ...
+//     i += record_advance(&rules[type], len);
+//   }
+//
+// Since all the rules are tried at each candidate location, a buffer
+// holding several types of record is scanned just once.
+//
+// Checksums [SIG p33, SonTek ADV manual p96] are computed from bytes
+// assembled in little-endian order, so they work the same way on all
+// processors.
+
+#ifndef RECORD_LOCATOR_H
+#define RECORD_LOCATOR_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define RECORD_SYNC_MAX 8
+#define RECORD_CHECKSUM_NONE 0
+#define RECORD_CHECKSUM_NORTEK 1 // seed + sum of 2-byte words
+#define RECORD_CHECKSUM_SONTEK 2 // seed + sum of bytes
+
+typedef struct {
+  unsigned char sync[RECORD_SYNC_MAX]; // bytes at start of record
+  int nsync;
+  int length;          // record length in bytes, or 0 to use length field
+  int length_offset;   // offset of 2-byte length field, or -1 if none
+  int length_unit;     // bytes per unit of length field
+  int id_offset;       // offset of an identifying byte, or -1 if none
+  unsigned char id;    // value of that byte
+  int checksum;        // a RECORD_CHECKSUM_* value
+  unsigned short seed; // starting value for checksum
+} record_rule;
+
+typedef struct {
+  const record_rule *rules;
+  int nrules;
+  int single_first;         // common first sync byte, or -1
+  unsigned char first[256]; // nonzero for first sync bytes
+  int *bad;                 // if not NULL, counts checksum failures by type
+} record_scanner;
+
+static inline void record_rule_init(record_rule *r)
+{
+  memset(r, 0, sizeof(record_rule));
+  r->length_offset = -1;
+  r->length_unit = 1;
+  r->id_offset = -1;
+  r->checksum = RECORD_CHECKSUM_NONE;
+}
+
+static inline void record_scanner_init(record_scanner *s,
+    const record_rule *rules, int nrules, int *bad)
+{
+  s->rules = rules;
+  s->nrules = nrules;
+  s->bad = bad;
+  memset(s->first, 0, 256);
+  s->single_first = nrules > 0 ? rules[0].sync[0] : -1;
+  for (int k = 0; k < nrules; k++) {
+    s->first[rules[k].sync[0]] = 1;
+    if (rules[k].sync[0] != s->single_first)
+      s->single_first = -1;
+    if (bad)
+      bad[k] = 0;
+  }
+}
+
+static inline unsigned short record_uint16(const unsigned char *p)
+{
+  return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+// Checksum of the 'len'-byte record at p, the last 2 bytes of which
+// hold the expected value.
+static inline int record_checksum_ok(const record_rule *r,
+    const unsigned char *p, int len)
+{
+  unsigned short sum = r->seed;
+  int n = len - 2;
+  if (r->checksum == RECORD_CHECKSUM_NORTEK) {
+    for (int i = 0; i + 1 < n; i += 2)
+      sum += record_uint16(p + i);
+  } else if (r->checksum == RECORD_CHECKSUM_SONTEK) {
+    for (int i = 0; i < n; i++)
+      sum += p[i];
+  } else {
+    return 1;
+  }
+  return sum == record_uint16(p + n);
+}
+
+// Length of a record matching rule r at p (with 'avail' bytes
+// available), 0 if it does not match, or -1 if everything matches
+// except the checksum.
+static inline int record_match(const record_rule *r,
+    const unsigned char *p, ptrdiff_t avail)
+{
+  if (avail < r->nsync || memcmp(p, r->sync, r->nsync))
+    return 0;
+  if (r->id_offset >= 0 && (avail <= r->id_offset || p[r->id_offset] != r->id))
+    return 0;
+  int len = r->length;
+  if (r->length_offset >= 0) {
+    if (avail < r->length_offset + 2)
+      return 0;
+    int field = r->length_unit * (int)record_uint16(p + r->length_offset);
+    if (len > 0 && field != len)
+      return 0;
+    len = field;
+  }
+  if (len < r->nsync || len < 2 || len > avail)
+    return 0;
+  if (!record_checksum_ok(r, p, len))
+    return -1;
+  return len;
+}
+
+// Where to look for the next record, after finding one. Records
+// without checksums are not trusted enough to skip over.
+static inline int record_advance(const record_rule *r, int len)
+{
+  return r->checksum == RECORD_CHECKSUM_NONE ? 1 : len;
+}
+
+// Offset of the first record at or after buf[from], or -1 if there is
+// none. The type (index into rules) and length are stored in *type
+// and *len. Rules are tried in order, so more specific rules should
+// come first.
+static inline ptrdiff_t record_next(record_scanner *s,
+    const unsigned char *buf, ptrdiff_t n, ptrdiff_t from, int *type, int *len)
+{
+  ptrdiff_t i = from;
+  while (i < n) {
+    if (s->single_first >= 0) {
+      const unsigned char *q = (const unsigned char *)memchr(buf + i, s->single_first, (size_t)(n - i));
+      if (!q)
+        return -1;
+      i = q - buf;
+    } else if (!s->first[buf[i]]) {
+      i++;
+      continue;
+    }
+    for (int k = 0; k < s->nrules; k++) {
+      int l = record_match(&s->rules[k], buf + i, n - i);
+      if (l > 0) {
+        *type = k;
+        *len = l;
+        return i;
+      }
+      if (l < 0 && s->bad)
+        s->bad[k]++;
+    }
+    i++;
+  }
+  return -1;
+}
+
+#endif
@@ -1,8 +1,108 @@
 /* vim: set expandtab shiftwidth=2 softtabstop=2 tw=70: */
 
 #include <Rcpp.h>
+#include <vector>
+#include <string.h>
+#include "record_locator.h"
 using namespace Rcpp;
 
+// Sizes of the sections of a SonTek ADP profile record [1 p82-86],
+// which holds, in order: the 80-byte header; for PC-ADP devices, an
+// extra header [2]; optional CTD, GPS and bottom-track sections; and
+// then the velocity, standard-deviation and amplitude data. A 2-byte
+// checksum follows the record.
+#define SONTEK_ADP_HEADER 80
+#define SONTEK_ADP_MAX_BEAMS 4
+#define SONTEK_ADP_PCADP (2*(8+SONTEK_ADP_MAX_BEAMS) + 2*SONTEK_ADP_MAX_BEAMS + SONTEK_ADP_MAX_BEAMS)
+#define SONTEK_ADP_CTD 16
+#define SONTEK_ADP_GPS 40
+#define SONTEK_ADP_BOTTOM_TRACK 18
+
+static inline int sontek_adp_chunk_length(int ctd, int gps, int bottom_track, int pcadp, int ncell, int nbeam)
+{
+  return SONTEK_ADP_HEADER + (pcadp ? SONTEK_ADP_PCADP : 0) +
+    (ctd ? SONTEK_ADP_CTD : 0) + (gps ? SONTEK_ADP_GPS : 0) +
+    (bottom_track ? SONTEK_ADP_BOTTOM_TRACK : 0) + 4 * ncell * nbeam;
+}
+
+// The layout is inferred from up to this many profiles, so that one
+// truncated or corrupt profile does not decide it for the whole file.
+#define SONTEK_ADP_PROBES 5
+
+// Flags for the optional sections of a layout, numbered 0 to 15. The
+// PC-ADP header comes first, so that it is the default if no checksum
+// matches, as read.adp.sontek() assumed before the layout was inferred.
+static inline void sontek_adp_combination(int combination, int *ctd, int *gps, int *bottom_track, int *pcadp)
+{
+  *ctd = combination & 1;
+  *gps = (combination >> 1) & 1;
+  *bottom_track = (combination >> 2) & 1;
+  *pcadp = !((combination >> 3) & 1);
+}
+
+// Whether a layout is consistent with the flags given by the caller,
+// each being 0, 1, or -1 if it is to be found.
+static inline int sontek_adp_allowed(int combination, int have_ctd, int have_gps, int have_bottom_track, int pcadp)
+{
+  int c, g, bt, p;
+  sontek_adp_combination(combination, &c, &g, &bt, &p);
+  return !((have_ctd >= 0 && c != (have_ctd != 0)) ||
+      (have_gps >= 0 && g != (have_gps != 0)) ||
+      (have_bottom_track >= 0 && bt != (have_bottom_track != 0)) ||
+      (pcadp >= 0 && p != (pcadp != 0)));
+}
+
+// The first allowed layout for which the profile at buf[at] has a
+// correct checksum, in the 2 bytes after the chunk, or -1 if none
+// does. The record length, including the checksum, is put in *length.
+static int sontek_adp_layout(const record_rule *rule, const unsigned char *buf, int nbuf, int at,
+    int ncell, int nbeam, int have_ctd, int have_gps, int have_bottom_track, int pcadp, int *length)
+{
+  for (int combination = 0; combination < 16; combination++) {
+    if (!sontek_adp_allowed(combination, have_ctd, have_gps, have_bottom_track, pcadp))
+      continue;
+    int c, g, bt, p;
+    sontek_adp_combination(combination, &c, &g, &bt, &p);
+    int l = sontek_adp_chunk_length(c, g, bt, p, ncell, nbeam) + 2;
+    if (at + l <= nbuf && record_checksum_ok(rule, buf + at, l)) {
+      *length = l;
+      return combination;
+    }
+  }
+  return -1;
+}
+
+// Little-endian decoders, safe for any alignment and host byte order.
+static inline int sontek_int16(const unsigned char *p)
+{
+  return (short)((unsigned short)p[0] | ((unsigned short)p[1] << 8));
+}
+
+static inline unsigned int sontek_uint16(const unsigned char *p)
+{
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static inline int sontek_int32(const unsigned char *p)
+{
+  return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+      ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static inline double sontek_double(const unsigned char *p)
+{
+  unsigned char b[8];
+  double d;
+#ifdef WORDS_BIGENDIAN
+  for (int k = 0; k < 8; k++)
+    b[k] = p[7 - k];
+#else
+  memcpy(b, p, 8);
+#endif
+  memcpy(&d, b, 8);
+  return(d);
+}
+
 // Cross-reference work:
 // 1. update ../src/registerDynamicSymbol.c with an item for this
 // 2. main code should use the autogenerated wrapper in ../R/RcppExports.R
@@ -17,11 +117,17 @@ IntegerVector do_ldc_sontek_adp(RawVector buf, IntegerVector have_ctd, IntegerVe
   // ldc = locate data chunk; _sontek_adp = for a SonTek ADV.
   // Arguments:
   //   buf = buffer with data
-  //   Shave_ctd = 1 if have CTD data (must be 0, for this version)
-  //   Shave_gps = 1 if have GPS data (must be 0, for this version)
-  //   Shave_bottom_track = 1 if have bottom-track data (must be 0, for this version)
-  //   Spcadp = 1 if device is a PCADP (which has longer headers)
-  //   Smax = number of profiles to get (set to <0 to get all)
+  //   have_ctd = 1 if have CTD data, 0 if not, or -1 to find out
+  //   have_gps = 1 if have GPS data, 0 if not, or -1 to find out
+  //   have_bottom_track = 1 if have bottom-track data, 0 if not, or -1 to find out
+  //   pcadp = 1 if device is a PCADP (which has longer headers), 0 if not, or -1 to find out
+  //   max = number of profiles to get (set to <0 to get all)
+  //
+  // Value:
+  //   Integer vector of profile locations (counting from 1), with
+  //   attribute "sections", a named integer vector indicating whether
+  //   CTD, GPS and bottom-track data are present, and attribute
+  //   "pcadp", indicating whether the records have the PCADP header.
   //
   // Method:
   //   The code checks for bytes as follows, and does a checksum on
@@ -31,6 +137,14 @@ IntegerVector do_ldc_sontek_adp(RawVector buf, IntegerVector have_ctd, IntegerVe
   //       2    0x10 (flag 2)
   //       3    0x50 (decimal 80, number of bytes in header)
   //       4+   See ADPManual_710.pdf, logical page 84 et seq.
+  //   The optional sections have distinct lengths, and so do their
+  //   sums, so any that are not specified are found by trying each
+  //   possible record length on a profile, accepting the one that
+  //   yields a correct checksum. This is done for the first few
+  //   profiles, and the layout that most of them have is used, with a
+  //   warning if some have another. If none has a correct checksum,
+  //   the profiles are taken to have no optional sections, and to have
+  //   the PCADP header unless pcadp is 0.
   //
   // REFERENCES
   //   1. see ADPManual_710.pdf, logical pages 82-86.
@@ -41,12 +155,6 @@ IntegerVector do_ldc_sontek_adp(RawVector buf, IntegerVector have_ctd, IntegerVe
 #ifdef DEBUG
   Rprintf("have_ctd=%d, have_bottom_track=%d, have_gps=%d, max=%d\n",have_ctd[0],have_bottom_track[0],have_gps[0],max[0]);
 #endif
-  if (have_ctd[0] != 0)
-    ::Rf_error("cannot read SonTek ADP files with CTD data");
-  if (have_bottom_track[0] != 0)
-    ::Rf_error("cannot read SonTek ADP files with bottom-track data");
-  if (have_gps[0] != 0)
-    ::Rf_error("cannot read SonTek ADP files with GPS data");
   int nbuf = buf.size();
 #ifdef DEBUG
   Rprintf("nbuf=%d\n", nbuf);
@@ -61,10 +169,11 @@ IntegerVector do_ldc_sontek_adp(RawVector buf, IntegerVector have_ctd, IntegerVe
   if (first_look > nbuf)
     ::Rf_error("cannot read Sontek ADP from a buffer with fewer than 1000 bytes");
   int i;
-  int ncell = -1, nbeam = -1;
+  int first = -1, ncell = -1, nbeam = -1;
   for (i = 0; i < first_look - 3; i++) { /* note that we don't look to the very end */
     //Rprintf(" %d: %x %x %x (%x %x %x)\n", i, buf[i], buf[i+1], buf[i+2], byte1, byte2, byte3);
     if (buf[i] == byte1 && buf[i+1] == byte2 && buf[i+2] == byte3) {
+      first = i;
       nbeam = (int)buf[i + 26];
       ncell = ((unsigned short)buf[i+30]) | ((unsigned short)buf[i+31] << 8);
 #ifdef DEBUG
@@ -80,66 +189,304 @@ IntegerVector do_ldc_sontek_adp(RawVector buf, IntegerVector have_ctd, IntegerVe
   }
   if (nbeam < 0 || ncell < 0)
     ::Rf_error("cannot determine #beams or #cells, based on first 1000 bytes in buffer");
-  // The next line envisions more data streams, e.g. ctd.
-  int chunk_length = 80 + (have_ctd[0]?16:0) + (have_gps[0]?40:0) + (have_bottom_track[0]?18:0) + 4 * ncell * nbeam;
-  // Next 2 lines acount for extra header in each PCADP profile; see ref 2.
-  int max_beams = 4;
-  int pcadp_extra_header_length = 2*(8+max_beams) + 2*max_beams + max_beams;
-  if (pcadp[0])
-    chunk_length += pcadp_extra_header_length;
-  int bad = 0, maxbad = 100;
+  record_rule rule;
+  record_rule_init(&rule);
+  rule.sync[0] = byte1;
+  rule.sync[1] = byte2;
+  rule.sync[2] = byte3;
+  rule.nsync = 3;
+  rule.checksum = RECORD_CHECKSUM_SONTEK;
+  rule.seed = check_sum_start;
+  // Find the layout of each of the first few profiles, moving past
+  // each one that has a correct checksum, or else to the next sync
+  // bytes, which may be a spurious match within a corrupt profile.
+  int votes[16] = {0};
+  int best = -1, checked = 0, tries = 0;
+  for (int at = first; at >= 0 && checked < SONTEK_ADP_PROBES && tries < 4 * SONTEK_ADP_PROBES; tries++) {
+    int l = 0;
+    int combination = sontek_adp_layout(&rule, &buf[0], nbuf, at, ncell, nbeam,
+        have_ctd[0], have_gps[0], have_bottom_track[0], pcadp[0], &l);
+    if (combination >= 0) {
+      votes[combination]++;
+      checked++;
+      if (best < 0 || votes[combination] > votes[best])
+        best = combination;
+    }
+    int next = combination >= 0 ? at + l : at + 1;
+    at = -1;
+    for (int k = next; k < nbuf - 2; k++) {
+      if (buf[k] == byte1 && buf[k+1] == byte2 && buf[k+2] == byte3) {
+        at = k;
+        break;
+      }
+    }
+  }
+  if (best < 0) {
+    for (best = 0; best < 15; best++)
+      if (sontek_adp_allowed(best, have_ctd[0], have_gps[0], have_bottom_track[0], pcadp[0]))
+        break;
+  } else if (votes[best] < checked) {
+    ::Rf_warning("only %d of the %d SonTek ADP profiles checked have the layout that is used; the others have another layout",
+        votes[best], checked);
+  }
+  int ctd, gps, bottom_track, pc;
+  sontek_adp_combination(best, &ctd, &gps, &bottom_track, &pc);
+  int chunk_length = sontek_adp_chunk_length(ctd, gps, bottom_track, pc, ncell, nbeam);
+  int maxbad = 100;
 #ifdef DEBUG
-  Rprintf("pcadp=%d pcadp_extra_header_length=%d max_beams=%d\n", pcadp[0], pcadp_extra_header_length, max_beams);
+  Rprintf("pcadp=%d ctd=%d gps=%d bottom_track=%d\n", pc, ctd, gps, bottom_track);
   Rprintf("bytes: 0x%x 0x%x 0x%x\n", byte1, byte2, byte3);
   Rprintf("chunk_length: %d\n", chunk_length);
 #endif
-  for (int i = 0; i < nbuf - 3 - chunk_length; i++) { // FIXME is 3 right, or needed?
-    if (buf[i] == byte1 && buf[i+1] == byte2 && buf[i+2] == byte3) {
-      unsigned short int check_sum = check_sum_start; // RHS is fixed
-      unsigned short int desired_check_sum = ((unsigned short)buf[i+chunk_length]) | ((unsigned short)buf[i+chunk_length+1] << 8);
-      for (int c = 0; c < chunk_length; c++)
-        check_sum += (unsigned short int)buf[i + c];
-      if (check_sum == desired_check_sum) {
-        matches++;
-#ifdef DEBUG
-        Rprintf("OK  at buf[%d]: check_sum=%d (should be %d); check_sum_start=%d\n",
-            i, check_sum, desired_check_sum, check_sum_start);
-#endif
-        if (max[0] != 0 && matches >= (unsigned int)max[0])
-          break;
-      } else {
+  rule.length = chunk_length + 2;
+  int bad = 0;
+  record_scanner scanner;
+  record_scanner_init(&scanner, &rule, 1, &bad);
+  std::vector<int> found;
+  ptrdiff_t at = 0;
+  int type, len;
+  while ((at = record_next(&scanner, &buf[0], nbuf, at, &type, &len)) >= 0) {
+    if (bad > maxbad)
+      break;
+    found.push_back((int)at + 1); /* the +1 is to get R pointers */
+    matches++;
 #ifdef DEBUG
-        Rprintf("BAD at buf[%d]: check_sum=%d (should be %d); check_sum_start=%d\n",
-            i, check_sum, desired_check_sum, check_sum_start);
+    Rprintf("OK  at buf[%d]\n", (int)at);
 #endif
-        if (bad++ > maxbad)
-          ::Rf_error("bad=%d exceeds maxbad=%d\n", bad, maxbad);
-      }
-    }
+    if (max[0] != 0 && matches >= (unsigned int)max[0])
+      break;
+    at += record_advance(&rule, len);
   }
-  /* allocate space, then run through whole buffer again, noting the matches */
+  if (bad > maxbad)
+    ::Rf_error("bad=%d exceeds maxbad=%d\n", bad, maxbad);
   unsigned int nres = matches;
   IntegerVector res(nres>0?nres:1, 1);
   if (nres > 0) {
-#ifdef DEBUG
-    Rprintf("getting space for %d matches\n", nres);
-#endif
-    unsigned int ires = 0;
-    for (int i=0; i<(nbuf-3-chunk_length); i++) { // FIXME is 3 right, or needed?
-      if (buf[i] == byte1 && buf[i+1] == byte2 && buf[i+2] == byte3) {
-        unsigned short int check_sum = check_sum_start; // RHS is fixed
-        unsigned short int desired_check_sum = ((unsigned short)buf[i+chunk_length]) | ((unsigned short)buf[i+chunk_length+1] << 8);
-        for (int c = 0; c < chunk_length; c++)
-          check_sum += (unsigned short int)buf[i + c];
-        if (check_sum == desired_check_sum)
-          res[ires++] = i + 1; /* the +1 is to get R pointers */
-        if (ires > nres)        /* FIXME: or +1? */
-          break;
-      }
-    }
-    return(res);
+    for (unsigned int ires = 0; ires < nres; ires++)
+      res[ires] = found[ires];
   } else {
     res[0] = NA_INTEGER;
   }
+  IntegerVector sections = IntegerVector::create(ctd, gps, bottom_track);
+  sections.names() = CharacterVector::create("ctd", "gps", "bottomTrack");
+  res.attr("sections") = sections;
+  res.attr("pcadp") = pc;
+  return(res);
+}
+
+/*
+
+Decode SonTek ADP profiles
+
+@description
+
+Decode the SonTek ADP profile records that start at the locations
+given by 'start', as found by do_ldc_sontek_adp(), including any CTD,
+GPS and bottom-track sections. This does in a single pass over the
+records the work that read.adp.sontek() and read.adp.sontek.serial()
+formerly did with readBin() calls inside a loop over profiles.
+
+@param buf raw vector holding the whole file.
+
+@param start integer vector holding the locations of the records
+within buf, counting from 1.
+
+@param sections integer vector of length 3, indicating whether the
+records have CTD, GPS and bottom-track sections; this is normally the
+"sections" attribute of the value of do_ldc_sontek_adp().
+
+@param pcadp integer, 1 if the device is a PC-ADP, which has an extra
+header section, or 0 otherwise.
+
+@value a list holding the following items.  "year", "month", "day",
+"hour", "minute" and "second" (including hundredths) give the time of
+each profile; "heading", "pitch" and "roll" (in degrees),
+"temperature" (in degC) and "pressure" (in dbar) are from the header.
+"v" holds velocity (in m/s for an ADP and in units of 0.1 m/s for a
+PC-ADP), as an array with dimensions length(start), number of cells
+and number of beams, and "std" and "amplitude" are raw arrays of the
+same dimension, holding velocity standard deviation and signal
+amplitude.  If CTD data are present, "ctdTemperature" (degC),
+"conductivity" (S/m), "ctdPressure" (dbar) and "salinity" are
+present; if GPS data are present, "gpsTime" (seconds past midnight,
+UTC), "latitude" and "longitude" (degrees) are present, along with
+"gps", a raw matrix holding the whole GPS section of each record; if
+bottom-track data are present, "br" (range, in m), "bv" (velocity,
+in m/s), "bq" (standard deviation, raw) and "ba" (amplitude, raw) are
+present, as matrices with one row per profile and one column per
+beam.
+
+@references
+
+1. SonTek/YSI. "ADP Acoustic Doppler Profiler Technical
+Documentation." Version 7.1, 2001 (file ADPManual_710.pdf), logical
+pages 82-86.
+
+@author
+
+Dan Kelley
+
+*/
+
+// [[Rcpp::export]]
+List do_sontek_adp_profiles(RawVector buf, IntegerVector start, IntegerVector sections, IntegerVector pcadp)
+{
+  R_xlen_t nbuf = buf.size();
+  R_xlen_t N = start.size();
+  if (sections.size() != 3)
+    ::Rf_error("sections must have 3 elements, but it has %d", (int)sections.size());
+  int ctd = sections[0] != 0, gps = sections[1] != 0, bottom_track = sections[2] != 0;
+  if (N < 1)
+    ::Rf_error("must have at least one profile");
+  const unsigned char *b = (const unsigned char *)RAW(buf);
+  // Things that do not change during a file are taken from the first
+  // profile [1 p84].
+  if (start[0] == NA_INTEGER || start[0] < 1 || start[0] - 1 + SONTEK_ADP_HEADER > nbuf)
+    ::Rf_error("start[1]=%d is outside the buffer", start[0]);
+  int nbeam = b[start[0] - 1 + 26];
+  int ncell = sontek_uint16(b + start[0] - 1 + 30);
+  if (nbeam < 1 || nbeam > SONTEK_ADP_MAX_BEAMS)
+    ::Rf_error("number of beams must be between 1 and %d, but it is %d", SONTEK_ADP_MAX_BEAMS, nbeam);
+  R_xlen_t n = (R_xlen_t)ncell * nbeam;
+  int chunk_length = sontek_adp_chunk_length(ctd, gps, bottom_track, pcadp[0], ncell, nbeam);
+
+  NumericVector year(N), month(N), day(N), hour(N), minute(N), second(N);
+  NumericVector heading(N), pitch(N), roll(N), temperature(N), pressure(N);
+  NumericVector v(N * n);
+  v.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  RawVector stdev(N * n);
+  stdev.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  RawVector amplitude(N * n);
+  amplitude.attr("dim") = IntegerVector::create(N, ncell, nbeam);
+  NumericVector ctdTemperature, conductivity, ctdPressure, salinity;
+  if (ctd) {
+    ctdTemperature = NumericVector(N);
+    conductivity = NumericVector(N);
+    ctdPressure = NumericVector(N);
+    salinity = NumericVector(N);
+  }
+  NumericVector gpsTime, latitude, longitude;
+  RawVector gpsRaw;
+  if (gps) {
+    gpsTime = NumericVector(N);
+    latitude = NumericVector(N);
+    longitude = NumericVector(N);
+    gpsRaw = RawVector(N * SONTEK_ADP_GPS);
+    gpsRaw.attr("dim") = IntegerVector::create(N, SONTEK_ADP_GPS);
+  }
+  NumericVector br, bv;
+  RawVector bq, ba;
+  if (bottom_track) {
+    br = NumericVector(N * nbeam);
+    br.attr("dim") = IntegerVector::create(N, nbeam);
+    bv = NumericVector(N * nbeam);
+    bv.attr("dim") = IntegerVector::create(N, nbeam);
+    bq = RawVector(N * nbeam);
+    bq.attr("dim") = IntegerVector::create(N, nbeam);
+    ba = RawVector(N * nbeam);
+    ba.attr("dim") = IntegerVector::create(N, nbeam);
+  }
+
+  // Within a record, cells vary fastest, then beams; in the output
+  // arrays, profiles vary fastest.
+  for (R_xlen_t i = 0; i < N; i++) {
+    if (start[i] == NA_INTEGER || start[i] < 1 || (R_xlen_t)start[i] - 1 + chunk_length > nbuf)
+      ::Rf_error("profile %ld (at start=%d) extends past the end of the buffer", (long)(i+1), start[i]);
+    const unsigned char *p = b + start[i] - 1;
+    if (p[26] != nbeam || (int)sontek_uint16(p + 30) != ncell)
+      ::Rf_error("profile %ld has %d beams and %d cells, but profile 1 has %d beams and %d cells",
+          (long)(i+1), p[26], sontek_uint16(p + 30), nbeam, ncell);
+    // Header [1 p84]
+    year[i] = sontek_uint16(p + 18);
+    day[i] = p[20];
+    month[i] = p[21];
+    minute[i] = p[22];
+    hour[i] = p[23];
+    second[i] = p[25] + 0.01 * p[24];
+    heading[i] = 0.1 * sontek_int16(p + 40);
+    pitch[i] = 0.1 * sontek_int16(p + 42);
+    roll[i] = 0.1 * sontek_int16(p + 44);
+    temperature[i] = 0.01 * sontek_int16(p + 46);
+    pressure[i] = 0.01 * sontek_uint16(p + 48);
+    const unsigned char *d = p + SONTEK_ADP_HEADER;
+    if (pcadp[0])
+      d += SONTEK_ADP_PCADP;
+    if (ctd) {
+      // CTD [1 p85]: four 4-byte integers
+      ctdTemperature[i] = 1e-4 * sontek_int32(d);
+      conductivity[i] = 1e-5 * sontek_int32(d + 4);
+      ctdPressure[i] = 1e-3 * sontek_int32(d + 8);
+      salinity[i] = 1e-4 * sontek_int32(d + 12);
+      d += SONTEK_ADP_CTD;
+    }
+    if (gps) {
+      // GPS [1 p85]: UTC time as hour, minute, second and hundredths,
+      // then latitude and longitude as 8-byte doubles; the remaining
+      // bytes are returned, undecoded, in 'gps'.
+      gpsTime[i] = 3600.0 * d[0] + 60.0 * d[1] + d[2] + 0.01 * d[3];
+      latitude[i] = sontek_double(d + 4);
+      longitude[i] = sontek_double(d + 12);
+      for (int k = 0; k < SONTEK_ADP_GPS; k++)
+        gpsRaw[i + N * k] = d[k];
+      d += SONTEK_ADP_GPS;
+    }
+    if (bottom_track) {
+      // Bottom track [1 p85]: range (cm) and velocity (mm/s) as 2-byte
+      // integers, then standard deviation and amplitude as bytes, each
+      // for 3 beams.
+      for (int k = 0; k < nbeam && k < 3; k++) {
+        br[i + N * k] = 0.01 * sontek_uint16(d + 2 * k);
+        bv[i + N * k] = 0.001 * sontek_int16(d + 6 + 2 * k);
+        bq[i + N * k] = d[12 + k];
+        ba[i + N * k] = d[15 + k];
+      }
+      d += SONTEK_ADP_BOTTOM_TRACK;
+    }
+    // Profile data [1 p86]
+    for (R_xlen_t k = 0; k < n; k++)
+      v[i + N * k] = 0.001 * sontek_int16(d + 2 * k);
+    d += 2 * n;
+    for (R_xlen_t k = 0; k < n; k++)
+      stdev[i + N * k] = d[k];
+    d += n;
+    for (R_xlen_t k = 0; k < n; k++)
+      amplitude[i + N * k] = d[k];
+    if (i % 10000 == 0)
+      R_CheckUserInterrupt();
+  }
+
+  List res;
+  res["year"] = year;
+  res["month"] = month;
+  res["day"] = day;
+  res["hour"] = hour;
+  res["minute"] = minute;
+  res["second"] = second;
+  res["heading"] = heading;
+  res["pitch"] = pitch;
+  res["roll"] = roll;
+  res["temperature"] = temperature;
+  res["pressure"] = pressure;
+  res["v"] = v;
+  res["std"] = stdev;
+  res["amplitude"] = amplitude;
+  if (ctd) {
+    res["ctdTemperature"] = ctdTemperature;
+    res["conductivity"] = conductivity;
+    res["ctdPressure"] = ctdPressure;
+    res["salinity"] = salinity;
+  }
+  if (gps) {
+    res["gpsTime"] = gpsTime;
+    res["latitude"] = latitude;
+    res["longitude"] = longitude;
+    res["gps"] = gpsRaw;
+  }
+  if (bottom_track) {
+    res["br"] = br;
+    res["bv"] = bv;
+    res["bq"] = bq;
+    res["ba"] = ba;
+  }
   return(res);
 }